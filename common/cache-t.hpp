@@ -3,11 +3,17 @@
 
 #include "lock.hpp"
 #include "cache.hpp"
+#include "vector.hpp"
 
 //#include "iostream.hpp"
 
 namespace acommon {
 
+// The list of entries may be searched without holding any lock, see
+// cache.cpp.  "lock" is held while loading new data so that it is
+// only loaded once, "list_lock" is only held while the list itself
+// is modified or walked and no other lock is acquired with it held.
+
 class GlobalCacheBase
 {
 public:
@@ -18,11 +24,32 @@ public: // but don't use
   GlobalCacheBase * * prev;
 protected:
   Cacheable * first;
+  int readers[2];  // number of searches in progress for each epoch
+  unsigned epoch;
+  Mutex sync_lock;
+  Mutex list_lock;
+  // statistics, hits is updated without any lock, misses, load_time
+  // and evictions are protected by list_lock
+  int hits;
+  unsigned misses;
+  unsigned evictions;
+  clock_t load_time;
   void del(Cacheable * d);
   void add(Cacheable * n);
+  unsigned begin_search();
+  void end_search(unsigned e) {atomic_dec(&readers[e]);}
+  void synchronize();
+  void detach_all(Vector<Cacheable *> & kept);
   GlobalCacheBase(const char * n);
   ~GlobalCacheBase();
+  friend void trim_caches();
+  friend void cache_stats(MutableContainer &);
+  friend void cache_memory_report(MutableContainer &);
+  friend bool reset_cache(const char *);
 public:
+  // "loaded" should be called after trying to load new data with
+  // the time at which the attempt started
+  void loaded(clock_t start);
   void release(Cacheable * d);
   void detach(Cacheable * d);
   void detach_all();
@@ -36,13 +63,21 @@ public:
   typedef typename Data::CacheKey Key;
 public:
   GlobalCache(const char * n) : GlobalCacheBase(n) {}
-  // "find" and "add" will _not_ acquire a lock
+  // "find" will _not_ acquire a lock, it returns the data with its
+  // refcount incremented.  Entries whose refcount already dropped to
+  // zero are skipped since they are about to be deleted.
   Data * find(const Key & key) {
-    D * cur = static_cast<D *>(first);
-    while (cur && !cur->cache_key_eq(key))
-      cur = static_cast<D *>(cur->next);
-    return cur;
+    unsigned e = begin_search();
+    Cacheable * cur = atomic_load(&first);
+    for (; cur; cur = atomic_load(&cur->next)) {
+      D * d = static_cast<D *>(cur);
+      if (d->cache_key_eq(key) && atomic_inc_not_zero(&d->refcount)) break;
+    }
+    end_search(e);
+    if (cur) atomic_inc(&hits);
+    return static_cast<D *>(cur);
   }
+  // "add" should be called with the lock held
   void add(Data * n) {GlobalCacheBase::add(n);}
   // "release" and "detach" _will_ acquire a lock
   void release(Data * d) {GlobalCacheBase::release(d);}
@@ -54,14 +89,17 @@ PosibErr<Data *> get_cache_data(GlobalCache<Data> * cache,
                                 typename Data::CacheConfig * config, 
                                 const typename Data::CacheKey & key)
 {
-  LOCK(&cache->lock);
   Data * n = cache->find(key);
   //CERR << "Getting " << key << " for " << cache->name << "\n";
-  if (n) {
-    n->refcount++;
-    return n;
-  }
+  if (n) return n;
+  trim_caches();
+  // check again with the lock held so that the data is only loaded once
+  LOCK(&cache->lock);
+  n = cache->find(key);
+  if (n) return n;
+  clock_t start = clock();
   PosibErr<Data *> res = Data::get_new(key, config);
+  cache->loaded(start);
   if (res.has_err()) {
     //CERR << "ERROR\n"; 
     return res;
@@ -78,14 +116,16 @@ PosibErr<Data *> get_cache_data(GlobalCache<Data> * cache,
                                 typename Data::CacheConfig2 * config2,
                                 const typename Data::CacheKey & key)
 {
-  LOCK(&cache->lock);
   Data * n = cache->find(key);
   //CERR << "Getting " << key << "\n";
-  if (n) {
-    n->refcount++;
-    return n;
-  }
+  if (n) return n;
+  trim_caches();
+  LOCK(&cache->lock);
+  n = cache->find(key);
+  if (n) return n;
+  clock_t start = clock();
   PosibErr<Data *> res = Data::get_new(key, config, config2);
+  cache->loaded(start);
   if (res.has_err()) {
     //CERR << "ERROR\n"; 
     return res;
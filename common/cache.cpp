@@ -1,75 +1,187 @@
 #include <assert.h>
+#include <stdio.h>
 
 #include "stack_ptr.hpp"
 #include "cache-t.hpp"
+#include "mutable_container.hpp"
+#include "mem_report.hpp"
 
 namespace acommon {
 
 static StackPtr<Mutex> global_cache_lock(new Mutex);
 static GlobalCacheBase * first_cache = 0;
 
+// the cache policy, see set_cache_policy
+static int keep_alive = 0;
+static int max_unused_kb = 0;
+static int num_kept = 0; // number of entries the caches hold a reference to
+
+static inline void drop_cache_ref(Cacheable * d)
+{
+  atomic_store(&d->cache_ref, 0);
+  atomic_dec(&num_kept);
+}
+
+#if defined USE_POSIX_MUTEX && !defined __GNUC__
+Mutex atomic_ops_lock;
+#endif
+
+//
+// The entries of a cache are searched without holding the lock.
+// Since a search only takes a reference to an entry if its refcount
+// is not already zero, whoever releases the last reference owns the
+// entry and is the only one that may delete it.  Before deleting, it
+// removes the entry from the list and then waits for all searches
+// which may still see the entry to finish.  For that, each search
+// registers itself in one of two counters, selected by the current
+// epoch.  "synchronize" switches the epoch, so new searches use the
+// other counter, and waits for the old counter to drop to zero.  A
+// search that read the old epoch but registered after the switch
+// notices that the epoch changed and starts over.
+//
+// The next pointer of a removed entry is left alone so that a search
+// positioned on it can still reach the rest of the list.
+//
+// When entries are kept alive by the cache policy the cache holds a
+// reference of its own, so that an unused entry has a refcount of
+// one and is revived by the next search that finds it.  Such entries
+// are only removed by trim_caches (or reset_cache) which gives up the
+// cache's reference after all locks are released.  A search can
+// still take a reference to an entry being removed, in which case it
+// is simply deleted when that reference is released.
+//
+
 void Cacheable::copy() const
 {
   //CERR << "COPY\n";
-  LOCK(&cache->lock);
-  copy_no_lock();
+  atomic_inc(&refcount);
+}
+
+unsigned GlobalCacheBase::begin_search()
+{
+  for (;;) {
+    unsigned e = atomic_load(&epoch) & 1;
+    atomic_inc(&readers[e]);
+    if ((atomic_load(&epoch) & 1) == e) return e;
+    atomic_dec(&readers[e]);
+  }
+}
+
+void GlobalCacheBase::synchronize()
+{
+  LOCK(&sync_lock);
+  unsigned e = epoch & 1;
+  atomic_store(&epoch, epoch + 1);
+  while (atomic_load(&readers[e]) != 0)
+    yield_thread();
 }
 
+// del requires the list_lock
 void GlobalCacheBase::del(Cacheable * n)
 {
-  *n->prev = n->next;
+  atomic_store(n->prev, n->next);
   if (n->next) n->next->prev = n->prev;
-  n->next = 0;
   n->prev = 0;
 }
 
 void GlobalCacheBase::add(Cacheable * n) 
 {
   assert(n->refcount > 0);
+  LOCK(&list_lock);
   n->next = first;
   n->prev = &first;
-  if (first) first->prev = &n->next;
-  first = n;
   n->cache = this;
+  if (atomic_load(&keep_alive) != 0) {
+    n->cache_ref = 1;
+    atomic_inc(&n->refcount);
+    atomic_inc(&num_kept);
+  }
+  if (first) first->prev = &n->next;
+  atomic_store(&first, n);
+}
+
+void GlobalCacheBase::loaded(clock_t start)
+{
+  LOCK(&list_lock);
+  ++misses;
+  load_time += clock() - start;
 }
 
 void GlobalCacheBase::release(Cacheable * d) 
 {
   //CERR << "RELEASE\n";
-  LOCK(&lock);
-  d->refcount--;
-  assert(d->refcount >= 0);
-  if (d->refcount != 0) return;
-  //CERR << "DEL\n";
-  if (d->attached()) del(d);
+  // d may be deleted by someone else as soon as the refcount is
+  // decremented, unless it dropped to zero
+  bool kept = atomic_load(&d->cache_ref);
+  if (kept) d->last_used = time(0);
+  int refcount = atomic_dec(&d->refcount);
+  assert(refcount >= 0);
+  if (refcount == 1 && kept) trim_caches();
+  if (refcount != 0) return;
+  {
+    LOCK(&list_lock);
+    //CERR << "DEL\n";
+    if (d->attached()) del(d);
+  }
+  // the lock is not held when deleting since the object may itself
+  // release other objects in the same cache
+  synchronize();
   delete d;
 }
 
 void GlobalCacheBase::detach(Cacheable * d)
 {
-  LOCK(&lock);
-  if (d->attached()) del(d);
+  bool kept;
+  {
+    LOCK(&list_lock);
+    if (!d->attached()) return;
+    del(d);
+    kept = d->cache_ref;
+    if (kept) drop_cache_ref(d);
+  }
+  if (kept) release(d);
 }
 
-void GlobalCacheBase::detach_all()
+// Detaches all entries, the entries the cache held a reference to
+// are added to kept and must be released once no lock is held.
+void GlobalCacheBase::detach_all(Vector<Cacheable *> & kept)
 {
-  LOCK(&lock);
+  LOCK(&list_lock);
   Cacheable * p = first;
   while (p) {
-    *p->prev = 0;
+    atomic_store(p->prev, (Cacheable *)0);
     p->prev = 0;
+    if (p->cache_ref) {
+      drop_cache_ref(p);
+      kept.push_back(p);
+    }
     p = p->next;
   }
 }
 
+static void release_all(const Vector<Cacheable *> & v)
+{
+  for (Vector<Cacheable *>::const_iterator i = v.begin(); i != v.end(); ++i)
+    (*i)->cache->release(*i);
+}
+
+void GlobalCacheBase::detach_all()
+{
+  Vector<Cacheable *> kept;
+  detach_all(kept);
+  release_all(kept);
+}
+
 void release_cache_data(GlobalCacheBase * cache, const Cacheable * d)
 {
   cache->release(const_cast<Cacheable *>(d));
 }
 
 GlobalCacheBase::GlobalCacheBase(const char * n)
-  : name (n)
+  : name (n), first(0), epoch(0), 
+    hits(0), misses(0), evictions(0), load_time(0)
 {
+  readers[0] = readers[1] = 0;
   LOCK(global_cache_lock);
   next = first_cache;
   prev = &first_cache;
@@ -79,7 +191,10 @@ GlobalCacheBase::GlobalCacheBase(const char * n)
 
 GlobalCacheBase::~GlobalCacheBase()
 {
-  detach_all();
+  // entries still kept alive are not deleted, at this point the
+  // caches they depend on may already be gone
+  Vector<Cacheable *> kept;
+  detach_all(kept);
   LOCK(global_cache_lock);
   *prev = next;
   if (next) next->prev = prev;
@@ -87,21 +202,161 @@ GlobalCacheBase::~GlobalCacheBase()
 
 bool reset_cache(const char * which)
 {
-  LOCK(global_cache_lock);
+  Vector<Cacheable *> kept;
   bool any = false;
-  for (GlobalCacheBase * i = first_cache; i; i = i->next)
   {
-    if (which && strcmp(i->name, which) == 0) {i->detach_all(); any = true;}
+    LOCK(global_cache_lock);
+    for (GlobalCacheBase * i = first_cache; i; i = i->next)
+    {
+      // a null which resets every cache, as documented for
+      // aspell_reset_cache
+      if (!which || strcmp(i->name, which) == 0) {
+        i->detach_all(kept);
+        any = true;
+      }
+    }
   }
+  release_all(kept);
   return any;
 }
 
+void set_cache_policy(int ka, int max_kb)
+{
+  {
+    LOCK(global_cache_lock);
+    atomic_store(&keep_alive, ka);
+    atomic_store(&max_unused_kb, max_kb < 0 ? 0 : max_kb);
+  }
+  trim_caches();
+}
+
+static inline bool unused(const Cacheable * d)
+{
+  return d->cache_ref && atomic_load(&d->refcount) == 1;
+}
+
+void trim_caches()
+{
+  if (atomic_load(&num_kept) == 0) return;
+  Vector<Cacheable *> evicted;
+  {
+    LOCK(global_cache_lock);
+    // Only trim_caches holds more than one list_lock at a time and it
+    // is serialized by the global lock.
+    GlobalCacheBase * c;
+    for (c = first_cache; c; c = c->next) c->list_lock.lock();
+    int ka = keep_alive;
+    size_t max_size = (size_t)max_unused_kb * 1024;
+    time_t now = time(0);
+    Vector<Cacheable *> unused;
+    for (c = first_cache; c; c = c->next) {
+      for (Cacheable * p = c->first; p; p = p->next) {
+        if (!p->cache_ref || atomic_load(&p->refcount) != 1) continue;
+        if (ka == 0 || (ka > 0 && now - p->last_used >= ka))
+          evicted.push_back(p);
+        else if (max_size > 0 && p->cache_size() > 0)
+          unused.push_back(p);
+      }
+    }
+    // keep the most recently used entries which fit into the budget
+    size_t total = 0;
+    while (!unused.empty()) {
+      Vector<Cacheable *>::iterator newest = unused.begin();
+      for (Vector<Cacheable *>::iterator i = unused.begin(); 
+           i != unused.end(); ++i)
+        if ((*i)->last_used > (*newest)->last_used) newest = i;
+      total += (*newest)->cache_size();
+      if (total > max_size) break;
+      unused.erase(newest);
+    }
+    evicted.insert(evicted.end(), unused.begin(), unused.end());
+    for (Vector<Cacheable *>::iterator i = evicted.begin(); 
+         i != evicted.end(); ++i) {
+      (*i)->cache->del(*i);
+      drop_cache_ref(*i);
+      ++(*i)->cache->evictions;
+    }
+    for (c = first_cache; c; c = c->next) c->list_lock.unlock();
+  }
+  // the entries are deleted once no lock is held since they may
+  // release other entries
+  release_all(evicted);
+}
+
+void cache_stats(MutableContainer & out)
+{
+  LOCK(global_cache_lock);
+  time_t now = time(0);
+  char buf[128];
+  String line;
+  for (GlobalCacheBase * c = first_cache; c; c = c->next) {
+    LOCK(&c->list_lock);
+    snprintf(buf, sizeof(buf), 
+             "%s: hits %d, misses %u, evictions %u, load time %.3f",
+             c->name, atomic_load(&c->hits), c->misses, c->evictions,
+             (double)c->load_time / CLOCKS_PER_SEC);
+    out.add(buf);
+    for (Cacheable * p = c->first; p; p = p->next) {
+      int refs = atomic_load(&p->refcount) - (p->cache_ref ? 1 : 0);
+      line = "  ";
+      line += p->cache_key_str();
+      snprintf(buf, sizeof(buf), ": refs %d, size %lu", 
+               refs, (unsigned long)p->cache_size());
+      line += buf;
+      if (refs == 0) {
+        snprintf(buf, sizeof(buf), ", unused %ld", (long)(now - p->last_used));
+        line += buf;
+      }
+      out.add(line);
+    }
+  }
+}
+
+void Cacheable::memory_usage(MemReport & r) const
+{
+  r.add(cache_key_str(), cache_size());
+}
+
+void cache_memory_report(MutableContainer & out)
+{
+  MemReport r;
+  {
+    LOCK(global_cache_lock);
+    for (GlobalCacheBase * c = first_cache; c; c = c->next) {
+      LOCK(&c->list_lock);
+      r.begin(c->name);
+      for (Cacheable * p = c->first; p; p = p->next)
+        p->memory_usage(r);
+      r.end();
+    }
+  }
+  r.write(out);
+}
+
 extern "C"
 int aspell_reset_cache(const char * which)
 {
   return reset_cache(which);
 }
 
+extern "C"
+void aspell_set_cache_policy(int keep_alive, int max_unused_kb)
+{
+  set_cache_policy(keep_alive, max_unused_kb);
+}
+
+extern "C"
+void aspell_cache_stats(MutableContainer * lst)
+{
+  cache_stats(*lst);
+}
+
+extern "C"
+void aspell_cache_memory_report(MutableContainer * lst)
+{
+  cache_memory_report(*lst);
+}
+
 #if 0
 
 struct CacheableImpl : public Cacheable
@@ -1,6 +1,8 @@
 #ifndef ACOMMON_CACHE__HPP
 #define ACOMMON_CACHE__HPP
 
+#include <time.h>
+
 #include "posib_err.hpp"
 
 namespace acommon {
@@ -8,8 +10,10 @@ namespace acommon {
 class GlobalCacheBase;
 template <class Data> class GlobalCache;
 
-// get_cache_data (both versions) and release_cache_data will acquires
-// the cache's lock
+// get_cache_data (both versions) will only acquire the cache's lock
+// if the data is not already in the cache, release_cache_data will
+// only acquire it when the last reference is released or when the
+// entry is kept alive by the cache policy
 
 template <class Data>
 PosibErr<Data *> get_cache_data(GlobalCache<Data> *, 
@@ -22,6 +26,7 @@ PosibErr<Data *> get_cache_data(GlobalCache<Data> *,
                                 const typename Data::CacheKey &);
 
 class Cacheable;
+class MemReport;
 void release_cache_data(GlobalCacheBase *, const Cacheable *);
 static inline void release_cache_data(const GlobalCacheBase * c, const Cacheable * d)
 {
@@ -35,12 +40,21 @@ public: // but don't use
   Cacheable * * prev;
   mutable int refcount;
   GlobalCacheBase * cache;
+  int cache_ref; // non zero if the cache holds a reference of its own
+  mutable time_t last_used;
 public:
   bool attached() {return prev;}
-  void copy_no_lock() const {refcount++;}
-  void copy() const; // Acquires cache->lock
-  void release() const {release_cache_data(cache,this);} // Acquires cache->lock
-  Cacheable(GlobalCacheBase * c = 0) : next(0), prev(0), refcount(1), cache(c) {}
+  void copy() const; // does not acquire cache->lock
+  void release() const {release_cache_data(cache,this);}
+  // for the cache statistics: the key in a readable form and the
+  // approximate amount of memory used, 0 if not known
+  virtual const char * cache_key_str() const {return "";}
+  virtual size_t cache_size() const {return 0;}
+  // adds the memory used to the report, by default a single line
+  // with the key and cache_size
+  virtual void memory_usage(MemReport &) const;
+  Cacheable(GlobalCacheBase * c = 0) 
+    : next(0), prev(0), refcount(1), cache(c), cache_ref(0), last_used(0) {}
   virtual ~Cacheable() {}
 };
 
@@ -79,7 +93,29 @@ PosibErr<void> setup(CachePtr<Data> & res,
   return no_err;
 }
 
-bool reset_cache(const char * = 0);
+// Resets the cache named which, or all of them if which is null, so
+// that the next query creates a new object.  Objects kept alive by the
+// cache policy are released.  Returns false if no cache was reset.
+bool reset_cache(const char * which = 0);
+
+// Unused entries are normally deleted as soon as the last reference
+// is released.  With a non zero keep_alive they are kept in the cache
+// for that many seconds (forever if negative) after the last release
+// so that they can be reused.  If max_unused_kb is not zero the least
+// recently used of them are deleted once the known size of all unused
+// entries exceeds it.  The policy applies to all caches.
+void set_cache_policy(int keep_alive, int max_unused_kb);
+
+// Deletes the unused entries that are no longer allowed by the policy.
+void trim_caches();
+
+class MutableContainer;
+// Adds a line for each cache with its counters followed by a line
+// for each of its entries.
+void cache_stats(MutableContainer &);
+
+// Adds a report of the memory used by the entries of each cache.
+void cache_memory_report(MutableContainer &);
 
 }
 
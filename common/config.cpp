@@ -29,6 +29,7 @@
 #include "file_util.hpp"
 #include "fstream.hpp"
 #include "getdata.hpp"
+#include "hash-t.hpp"
 #include "itemize.hpp"
 #include "mutable_container.hpp"
 #include "posib_err.hpp"
@@ -78,6 +79,114 @@ namespace acommon {
                                      1, 1, 1, 0};
   
   typedef Notifier * NotifierPtr;
+
+  //
+  // The keys of the main and extra tables are indexed by name, and so
+  // are the entries of a committed config so that retrieving a value
+  // does not have to scan the list of entries.  Anything which changes
+  // the list of entries must clear indexed_ and then call
+  // index_entries() when done, until then the list is scanned.  When
+  // the entries were only added at either end of the list
+  // index_appended() or index_prepended() can be called instead so
+  // that adding one entry does not rebuild the whole index.
+  //
+
+  struct CStrEqual {
+    bool operator() (const char * x, const char * y) const {
+      return strcmp(x, y) == 0;
+    }
+  };
+
+  struct Config::KeyEntries {
+    const Entry * last;         // the entry returned by lookup
+    Vector<const Entry *> list; // the entries used by lookup_list
+    KeyEntries() : last(0) {}
+    void add(const Entry * e) {
+      if (e->action != NoOp) last = e;
+      if (list.empty() || e->action == Reset 
+          || e->action == Set || e->action == ListClear)
+        list.clear();
+      list.push_back(e);
+    }
+  };
+
+  struct Config::Index {
+    typedef hash_map<const char *, const KeyInfo *, 
+                     hash<const char *>, CStrEqual> Keys;
+    typedef hash_map<const char *, KeyEntries, 
+                     hash<const char *>, CStrEqual> Entries;
+    Keys    keys;
+    Entries entries;
+  };
+
+  void Config::index_keys()
+  {
+    index_->keys.clear();
+    for (const KeyInfo * i = keyinfo_begin; i != keyinfo_end; ++i)
+      index_->keys.insert(Index::Keys::value_type(i->name, i));
+    for (const KeyInfo * i = extra_begin; i != extra_end; ++i)
+      index_->keys.insert(Index::Keys::value_type(i->name, i));
+  }
+
+  void Config::index_entries()
+  {
+    index_->entries.clear();
+    indexed_ = committed_;
+    if (!indexed_) return;
+    for (const Entry * cur = first_; cur; cur = cur->next)
+      index_->entries[cur->key.str()].add(cur);
+  }
+
+  // was_indexed is the value of indexed_ from before the entries
+  // starting at begin were added to the end of the list.  If indexed_
+  // is set again something rebuilt the index in the mean time, so it
+  // can't be trusted to not already contain them.
+  void Config::index_appended(const Entry * begin, bool was_indexed)
+  {
+    if (!was_indexed || indexed_ || *insert_point_) {
+      index_entries();
+      return;
+    }
+    for (const Entry * cur = begin; cur; cur = cur->next)
+      index_->entries[cur->key.str()].add(cur);
+    indexed_ = true;
+  }
+
+  // Same as index_appended() but for entries added to the front of
+  // the list up to end.  The entries of a key in the index are all
+  // the ones after the last one which cleared the list, so adding
+  // them after the new ones gives the same result as adding every
+  // entry of the key again.
+  void Config::index_prepended(const Entry * end, bool was_indexed)
+  {
+    if (!was_indexed || indexed_) {
+      index_entries();
+      return;
+    }
+    Index::Entries added;
+    for (const Entry * cur = first_; cur != end; cur = cur->next)
+      added[cur->key.str()].add(cur);
+    for (Index::Entries::iterator i = added.begin(); i != added.end(); ++i) {
+      KeyEntries & entries = index_->entries[i->first];
+      Vector<const Entry *>::const_iterator j = entries.list.begin();
+      for (; j != entries.list.end(); ++j)
+        i->second.add(*j);
+      entries = i->second;
+    }
+    indexed_ = true;
+  }
+
+  const Config::KeyEntries * Config::find_entries(const char * key, 
+                                                  KeyEntries & tmp) const
+  {
+    if (indexed_) {
+      Index::Entries::const_iterator i = index_->entries.find(key);
+      return i == index_->entries.end() ? 0 : &i->second;
+    }
+    for (const Entry * cur = first_; cur; cur = cur->next)
+      if (cur->key == key) tmp.add(cur);
+    return &tmp;
+  }
   
   Config::Config(ParmStr name,
 		 const KeyInfo * mainbegin, 
@@ -86,6 +195,7 @@ namespace acommon {
     , first_(0), insert_point_(&first_), others_(0)
     , committed_(true), attached_(false)
     , md_info_list_index(-1)
+    , index_(new Index), indexed_(false)
     , settings_read_in_(false)
     , load_filter_hook(0)
     , filter_mode_notifier(0)
@@ -94,13 +204,17 @@ namespace acommon {
     keyinfo_end   = mainend;
     extra_begin = 0;
     extra_end   = 0;
+    index_keys();
+    index_entries();
   }
 
   Config::~Config() {
     del();
+    delete index_;
   }
 
   Config::Config(const Config & other) 
+    : index_(new Index)
   {
     copy(other);
   }
@@ -147,6 +261,9 @@ namespace acommon {
 
     md_info_list_index = other.md_info_list_index;
 
+    index_->keys = other.index_->keys;
+    indexed_ = false;
+
     insert_point_ = 0;
     Entry * const * src  = &other.first_;
     Entry * * dest = &first_;
@@ -161,6 +278,7 @@ namespace acommon {
     if (insert_point_ == 0)
       insert_point_ = dest;
     *dest = 0;
+    index_entries();
 
     Vector<Notifier *>::const_iterator i   = other.notifier_list.begin();
     Vector<Notifier *>::const_iterator end = other.notifier_list.end();
@@ -174,6 +292,9 @@ namespace acommon {
 
   void Config::del()
   {
+    indexed_ = false;
+    index_->entries.clear();
+
     while (first_) {
       Entry * tmp = first_->next;
       delete first_;
@@ -219,6 +340,7 @@ namespace acommon {
   {
     extra_begin = begin;
     extra_end   = end;
+    index_keys();
   }
 
   //
@@ -304,13 +426,9 @@ namespace acommon {
 
   const Config::Entry * Config::lookup(const char * key) const
   {
-    const Entry * res = 0;
-    const Entry * cur = first_;
-
-    while (cur) {
-      if (cur->key == key && cur->action != NoOp)  res = cur;
-      cur = cur->next;
-    }
+    KeyEntries tmp;
+    const KeyEntries * k = find_entries(key, tmp);
+    const Entry * res = k ? k->last : 0;
 
     if (!res || res->action == Reset) return 0;
     return res;
@@ -387,51 +505,40 @@ namespace acommon {
                            MutableContainer & m,
                            bool include_default) const
   {
-    const Entry * cur = first_;
-    const Entry * first_to_use = 0;
-
-    while (cur) {
-      if (cur->key == ki->name && 
-          (first_to_use == 0 || 
-           cur->action == Reset || cur->action == Set 
-           || cur->action == ListClear)) 
-        first_to_use = cur;
-      cur = cur->next;
-    }
-
-    cur = first_to_use;
+    // the entries start with the last one which resets the list
+    KeyEntries tmp;
+    const KeyEntries * k = find_entries(ki->name, tmp);
+    const Entry * const * cur = k ? k->list.pbegin() : 0;
+    const Entry * const * end = k ? k->list.pend()   : 0;
 
     if (include_default && 
-        (!cur || 
-         !(cur->action == Set || cur->action == ListClear)))
+        (cur == end || 
+         !((*cur)->action == Set || (*cur)->action == ListClear)))
     {
       String def = get_default(ki);
       separate_list(def, m, true);
     }
 
-    if (cur && cur->action == Reset) {
-      cur = cur->next;
+    if (cur != end && (*cur)->action == Reset) {
+      ++cur;
     }
 
-    if (cur && cur->action == Set) {
+    if (cur != end && (*cur)->action == Set) {
       if (!include_default) m.clear();
-      m.add(cur->value);
-      cur = cur->next;
+      m.add((*cur)->value);
+      ++cur;
     }
 
-    if (cur && cur->action == ListClear) {
+    if (cur != end && (*cur)->action == ListClear) {
       if (!include_default) m.clear();
-      cur = cur->next;
+      ++cur;
     }
 
-    while (cur) {
-      if (cur->key == ki->name) {
-        if (cur->action == ListAdd)
-          m.add(cur->value);
-        else if (cur->action == ListRemove)
-          m.remove(cur->value);
-      }
-      cur = cur->next;
+    for (; cur != end; ++cur) {
+      if ((*cur)->action == ListAdd)
+        m.add((*cur)->value);
+      else if ((*cur)->action == ListRemove)
+        m.remove((*cur)->value);
     }
   }
 
@@ -474,13 +581,10 @@ namespace acommon {
   {
     typedef PosibErr<const KeyInfo *> Ret;
     {
+      Index::Keys::const_iterator f = index_->keys.find(key.str());
+      if (f != index_->keys.end()) return Ret(f->second);
+
       const KeyInfo * i;
-      i = acommon::find(key, keyinfo_begin, keyinfo_end);
-      if (i != keyinfo_end) return Ret(i);
-      
-      i = acommon::find(key, extra_begin, extra_end);
-      if (i != extra_end) return Ret(i);
-      
       const char * s = strncmp(key, "f-", 2) == 0 ? key + 2 : key.str();
       const char * h = strchr(s, '-');
       if (h == 0) goto err;
@@ -788,9 +892,12 @@ namespace acommon {
     entry->key = key;
     entry->value = value;
     entry->action = Set;
+    bool was_indexed = indexed_;
+    indexed_ = false;
     entry->next = *insert_point_;
     *insert_point_ = entry;
     insert_point_ = &entry->next;
+    index_appended(entry, was_indexed);
   }
 
   PosibErr<void> Config::replace(ParmStr key, ParmStr value)
@@ -856,7 +963,10 @@ namespace acommon {
       *insert_point_ = entry;
       insert_point_ = &entry->next;
       entry.release();
+      bool was_indexed = indexed_;
+      indexed_ = false;
       if (committed_) RET_ON_ERR(commit(entry0)); // entry0 == entry
+      index_appended(entry0, was_indexed);
       
     } else { // action == ListSet
 
@@ -877,15 +987,23 @@ namespace acommon {
   PosibErr<void> Config::merge(const Config & other)
   {
     const Entry * src  = other.first_;
+    const Entry * begin = 0;
+    bool was_indexed = indexed_, rebuilt = false;
+    indexed_ = false;
     while (src) 
     {
       Entry * entry = new Entry(*src);
       entry->next = *insert_point_;
       *insert_point_ = entry;
       insert_point_ = &entry->next;
+      if (!begin) begin = entry;
       if (committed_) RET_ON_ERR(commit(entry));
+      // committing an entry may set another one which rebuilds the
+      // index, it must not be used until all the entries are added
+      if (indexed_) {rebuilt = true; indexed_ = false;}
       src = src->next;
     }
+    index_appended(begin, was_indexed && !rebuilt);
     return no_err;
   }
 
@@ -896,6 +1014,8 @@ namespace acommon {
     to_utf8.setup(*this, data_encoding, "utf-8", NormTo);
     const Entry * src  = other.first_;
     Entry * * ip = &first_;
+    bool was_indexed = indexed_;
+    indexed_ = false;
     while (src)
     {
       const KeyInfo * l_ki = other.keyinfo(src->key);
@@ -910,6 +1030,7 @@ namespace acommon {
       }
       src = src->next;
     }
+    index_prepended(*ip, was_indexed);
   }
 
 
@@ -1310,6 +1431,7 @@ namespace acommon {
   PosibErr<void> Config::commit_all(Vector<int> * phs, const char * codeset)
   {
     committed_ = true;
+    indexed_ = false;
     others_ = first_;
     first_ = 0;
     insert_point_ = &first_;
@@ -1325,6 +1447,7 @@ namespace acommon {
         phs->push_back(place_holder);
       insert_point_ = &((*insert_point_)->next);
     }
+    index_entries();
     return no_err;
   }
 
@@ -1334,6 +1457,7 @@ namespace acommon {
     } else if (!val && committed_) {
       assert(empty());
       committed_ = false;
+      index_entries();
     }
     return no_err;
   }
@@ -1367,12 +1491,16 @@ namespace acommon {
        N_("create dictionary aliases")}
     , {"dict-dir", KeyInfoString, DICT_DIR,
        N_("location of the main word list")}
+    , {"dict-index", KeyInfoString, "",
+       N_("file to keep the list of installed dictionaries in")}
     , {"encoding",   KeyInfoString, "!encoding",
        N_("encoding to expect data to be in"), KEYINFO_COMMON}
     , {"filter",   KeyInfoList  , "url",
        N_("add or removes a filter"), KEYINFO_MAY_CHANGE}
     , {"filter-path", KeyInfoList, DICT_DIR,
        N_("path(s) aspell looks for filters")}
+    , {"fuse-filters", KeyInfoBool, "true",
+       N_("run filters over the document in a single pass when possible")}
     //, {"option-path", KeyInfoList, DATA_DIR,
     //   N_("path(s) aspell looks for options descriptions")}
     , {"mode",     KeyInfoString, "url",
@@ -1424,6 +1552,8 @@ namespace acommon {
     , {"personal", KeyInfoString, PERSONAL,
        N_("personal dictionary file name")}
     , {"personal-path", KeyInfoString, "<home-dir/personal>", 0}
+    , {"personal-snapshot", KeyInfoInt, "10000",
+       N_("compile personal word lists with this many new words, 0 to disable")}
     , {"prefix",   KeyInfoString, PREFIX,
        N_("prefix directory")}
     , {"repl",     KeyInfoString, REPL,
@@ -1455,6 +1585,8 @@ namespace acommon {
        N_("use replacement tables, override sug-mode default")}
     , {"sug-split-char", KeyInfoList, "\\ :-",
        N_("characters to insert when a word is split"), KEYINFO_UTF8}
+    , {"threads", KeyInfoInt, "1",
+       N_("number of threads to use when checking documents")}
     , {"use-other-dicts", KeyInfoBool, "true",
        N_("use personal, replacement & session dictionaries")}
     , {"variety", KeyInfoList, "",
@@ -1496,6 +1628,8 @@ namespace acommon {
     //
     , {"backup",  KeyInfoBool, "true",
        N_("create a backup file by appending \".bak\"")}
+    , {"buffer-pipe", KeyInfoBool, "false",
+       N_("only flush pipe mode output when waiting for input")}
     , {"byte-offsets", KeyInfoBool, "false",
        N_("use byte offsets instead of character offsets")}
     , {"guess", KeyInfoBool, "false",
@@ -1504,6 +1638,8 @@ namespace acommon {
        N_("keymapping for check mode: \"aspell\" or \"ispell\"")}
     , {"reverse", KeyInfoBool, "false",
        N_("reverse the order of the suggest list")}
+    , {"stats", KeyInfoBool, "false",
+       N_("print counters of the work done to stderr on exit")}
     , {"suggest", KeyInfoBool, "true",
        N_("suggest possible replacements"), KEYINFO_MAY_CHANGE}
     , {"time"   , KeyInfoBool, "false",
@@ -127,6 +127,19 @@ namespace acommon {
 
     int md_info_list_index;
 
+    // indexes of the keys and the entries, the entry index is only
+    // used when indexed_ is true
+    struct KeyEntries;
+    struct Index;
+    Index * index_;
+    bool    indexed_;
+
+    void index_keys();
+    void index_entries();
+    void index_appended(const Entry * begin, bool was_indexed);
+    void index_prepended(const Entry * end, bool was_indexed);
+    const KeyEntries * find_entries(const char * key, KeyEntries & tmp) const;
+
     void copy(const Config & other);
     void del();
 
@@ -19,6 +19,7 @@
 #include "file_util.hpp"
 #include "file_data_util.hpp"
 #include "vararray.hpp"
+#include "mem_report.hpp"
 
 #include "iostream.hpp"
 
@@ -510,6 +511,30 @@ namespace acommon {
 
   }
 
+  template <class T>
+  static size_t norm_table_size(const NormTable<T> * d)
+  {
+    size_t size = NormTable<T>::struct_size + sizeof(T) * (d->end - d->data);
+    for (const T * cur = d->data; cur != d->end; ++cur) {
+      if (cur->sub_table) 
+        size += norm_table_size<T>(static_cast<NormTable<T> *>(cur->sub_table));
+    }
+    return size;
+  }
+
+  size_t NormTables::cache_size() const
+  {
+    size_t size = sizeof(*this) + norm_table_size<FromUniNormEntry>(internal);
+    if (strict_d)
+      size += norm_table_size<FromUniNormEntry>(strict_d);
+    for (unsigned i = 0; i != to_uni.size(); ++i) {
+      size += sizeof(ToUniTable);
+      if (to_uni[i].data)
+        size += norm_table_size<ToUniNormEntry>(to_uni[i].data);
+    }
+    return size;
+  }
+
   NormTables::~NormTables()
   {
     free_norm_table<FromUniNormEntry>(internal);
@@ -1012,6 +1037,16 @@ namespace acommon {
 
   Convert::~Convert() {}
 
+  void Convert::memory_usage(MemReport & r, ParmStr name) const
+  {
+    r.begin(name);
+    if (norm_tables_)
+      norm_tables_->memory_usage(r);
+    r.add("buffer", buf_.capacity() * sizeof(FilterChar));
+    filter.memory_usage(r);
+    r.end();
+  }
+
   PosibErr<void> Convert::init(const Config & c, ParmStr in, ParmStr out)
   {
     RET_ON_ERR(setup(decode_c, &decode_cache, &c, in));
@@ -26,6 +26,7 @@ namespace acommon {
     typedef const char * CacheKey;
     String key;
     bool cache_key_eq(const char * l) const  {return key == l;}
+    const char * cache_key_str() const {return key.str();}
     ConvBase() {}
   private:
     ConvBase(const ConvBase &);
@@ -75,6 +76,7 @@ namespace acommon {
     typedef const char * CacheKey;
     String key;
     bool cache_key_eq(const char * l) const  {return key == l;}
+    const char * cache_key_str() const {return key.str();}
     static PosibErr<NormTables *> get_new(const String &, const Config *);
     NormTable<FromUniNormEntry> * internal;
     NormTable<FromUniNormEntry> * strict_d;
@@ -87,6 +89,7 @@ namespace acommon {
     };
     typedef Vector<ToUniTable> ToUni;
     Vector<ToUniTable> to_uni;
+    size_t cache_size() const;
     ~NormTables();
   };
 
@@ -122,6 +125,10 @@ namespace acommon {
     PosibErr<void> init(const Config &, ParmStr in, ParmStr out);
     PosibErr<void> init_norm_to(const Config &, ParmStr in, ParmStr out);
     PosibErr<void> init_norm_from(const Config &, ParmStr in, ParmStr out);
+
+    // adds the memory used by the converter and its filters to the
+    // report
+    void memory_usage(MemReport &, ParmStr name) const;
     
     const char * in_code() const   {return decode_->key.c_str();}
     const char * out_code() const  {return encode_->key.c_str();}
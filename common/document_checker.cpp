@@ -9,13 +9,60 @@
 #include "convert.hpp"
 #include "speller.hpp"
 #include "config.hpp"
+#include "stack_ptr.hpp"
+#include "thread.hpp"
+#include "stats.hpp"
+
+#include <string.h>
+#include <time.h>
 
 namespace acommon {
 
-  DocumentChecker::DocumentChecker() 
-    : status_fun_(0), speller_(0) {}
-  DocumentChecker::~DocumentChecker() 
+  // Strings with fewer characters than this per thread are not worth
+  // splitting up.
+  static const unsigned int min_chunk_size = 16384;
+
+  struct DocumentChecker::Worker {
+    StackPtr<Tokenizer> tokenizer;
+    StackPtr<CheckContext> context;
+    Speller * speller;
+    FilterChar * begin;
+    FilterChar * end;
+    unsigned int pos;
+    Vector<Token> misspellings;
+    Thread thread;
+    static void * run(void *);
+  };
+
+  void * DocumentChecker::Worker::run(void * d)
   {
+    Worker * w = static_cast<Worker *>(d);
+    Tokenizer * tok = w->tokenizer;
+    tok->reset(w->begin, w->end);
+    unsigned long tokens = 0;
+    while (tok->advance()) {
+      ++tokens;
+      bool correct = w->speller->check(MutableString(tok->word.data(),
+                                                     tok->word.size() - 1),
+                                       w->context);
+      if (!correct) {
+        Token t;
+        t.offset = w->pos + tok->begin_pos;
+        t.len    = tok->end_pos - tok->begin_pos;
+        w->misspellings.push_back(t);
+      }
+    }
+    stat_add(STAT_DOC_TOKEN, tokens);
+    return 0;
+  }
+
+  DocumentChecker::DocumentChecker()
+    : status_fun_(0), speller_(0), num_threads_(1), parallel_(false), next_(0) {}
+  DocumentChecker::~DocumentChecker()
+  {
+    for (Vector<Worker *>::iterator i = workers_.begin();
+         i != workers_.end(); ++i)
+      delete *i;
   }
 
   PosibErr<void> DocumentChecker
@@ -25,10 +72,12 @@ namespace acommon {
     filter_.reset(filter);
     speller_ = speller;
     conv_ = speller->to_internal_;
+    int threads = speller->config()->retrieve_int("threads");
+    num_threads_ = threads > 1 ? threads : 1;
     return no_err;
   }
 
-  void DocumentChecker::set_status_fun(void (* sf)(void *, Token, int), 
+  void DocumentChecker::set_status_fun(void (* sf)(void *, Token, int),
 				       void * d)
   {
     status_fun_ = sf;
@@ -48,21 +97,115 @@ namespace acommon {
     proc_str_.append(0);
     FilterChar * begin = proc_str_.pbegin();
     FilterChar * end   = proc_str_.pend() - 1;
-    if (filter_)
+    bool stats_on = atomic_load(&stats_enabled);
+    if (stats_on)
+      stat_add(STAT_DOC_BYTE, size < 0 ? strlen(str) : size);
+    if (filter_ && (stats_on || atomic_load(&trace_hook))) {
+      clock_t start = clock();
+      filter_->process(begin, end);
+      long usec = (long)((double)(clock() - start) * 1000000 / CLOCKS_PER_SEC);
+      stat_add(STAT_FILTER_USEC, usec);
+      trace("filter", "", usec);
+    } else if (filter_) {
       filter_->process(begin, end);
-    tokenizer_->reset(begin, end);
+    }
+    misspellings_.clear();
+    next_ = 0;
+    parallel_ = (num_threads_ > 1 && !status_fun_
+                 && (unsigned)(end - begin) >= 2 * min_chunk_size);
+    if (parallel_)
+      process_parallel(begin, end);
+    else
+      tokenizer_->reset(begin, end);
+  }
+
+  void DocumentChecker::process_parallel(FilterChar * begin, FilterChar * end)
+  {
+    unsigned int num = (end - begin) / min_chunk_size;
+    if (num > num_threads_) num = num_threads_;
+    unsigned int chunk_size = (end - begin) / num;
+
+    // The string is split right after a line break, or a space if a
+    // line is too long, since no word can span either.  The
+    // character is replaced with a null so that it ends the piece
+    // before it, its width is kept so the positions stay the same.
+    FilterChar * cur = begin;
+    unsigned int pos = 0;
+    unsigned int i = 0;
+    for (; cur != end; ++i) {
+      if (i == workers_.size()) {
+        // if anything goes wrong the rest is checked in this thread
+        PosibErr<CheckContext *> ctx = speller_->new_check_context();
+        if (ctx.has_err()) {parallel_ = false; break;}
+        StackPtr<CheckContext> context(ctx.data);
+        PosibErr<Tokenizer *> tok = new_tokenizer(speller_);
+        if (tok.has_err()) {parallel_ = false; break;}
+        Worker * w = new Worker;
+        w->context.reset(context.release());
+        w->tokenizer.reset(tok.data);
+        w->speller = speller_;
+        workers_.push_back(w);
+      }
+      Worker * w = workers_[i];
+      w->misspellings.clear();
+      w->begin = cur;
+      w->pos = pos;
+      FilterChar * stop = i + 1 >= num || (unsigned)(end - cur) <= chunk_size
+        ? end : cur + chunk_size;
+      if (stop != end) {
+        FilterChar * p = stop;
+        while (p != end && *p != '\n') ++p;
+        if (p - stop > (int)chunk_size) {
+          p = stop;
+          while (p != end && *p != ' ' && *p != '\t' && *p != '\n') ++p;
+        }
+        stop = p;
+      }
+      w->end = stop;
+      pos += FilterChar::sum(cur, stop);
+      if (stop != end) {
+        pos += stop->width;
+        stop->chr = 0;
+        ++stop;
+      }
+      cur = stop;
+    }
+    unsigned int num_workers = i;
+    for (i = 0; i != num_workers; ++i)
+      workers_[i]->thread.start(Worker::run, workers_[i]);
+    for (i = 0; i != num_workers; ++i) {
+      Worker * w = workers_[i];
+      w->thread.join();
+      misspellings_.insert(misspellings_.end(),
+                           w->misspellings.begin(), w->misspellings.end());
+    }
+    if (!parallel_) {
+      // the rest of the string is checked the normal way
+      tokenizer_->reset(cur, end);
+      tokenizer_->end_pos = pos;
+    }
   }
 
   Token DocumentChecker::next_misspelling()
   {
     bool correct;
     Token tok;
+    if (next_ != misspellings_.size()) {
+      return misspellings_[next_++];
+    } else if (parallel_) {
+      tok.offset = proc_str_.size();
+      tok.len = 0;
+      return tok;
+    }
+    unsigned long tokens = 0;
     do {
       if (!tokenizer_->advance()) {
 	tok.offset = proc_str_.size();
 	tok.len = 0;
+        stat_add(STAT_DOC_TOKEN, tokens);
 	return tok;
       }
+      ++tokens;
       correct = speller_->check(MutableString(tokenizer_->word.data(),
 					      tokenizer_->word.size() - 1));
       tok.len  = tokenizer_->end_pos - tokenizer_->begin_pos;
@@ -70,8 +213,8 @@ namespace acommon {
       if (status_fun_)
 	(*status_fun_)(status_fun_data_, tok, correct);
     } while (correct);
+    stat_add(STAT_DOC_TOKEN, tokens);
     return tok;
   }
 
 }
-
@@ -13,6 +13,7 @@
 #include "can_have_error.hpp"
 #include "filter_char.hpp"
 #include "filter_char_vector.hpp"
+#include "vector.hpp"
 
 namespace acommon {
 
@@ -20,6 +21,7 @@ namespace acommon {
   class Speller;
   class Tokenizer;
   class Convert;
+  class CheckContext;
 
   struct Token {
     unsigned int offset;
@@ -41,11 +43,26 @@ namespace acommon {
     Filter * filter() {return filter_;}
 
     void set_status_fun(void (*)(void *, Token, int), void *); 
+
+    // If more than one thread is used, large strings passed to
+    // process are split at line breaks after they are filtered and
+    // the pieces are checked in parallel.  This is not done when a
+    // status function is set.  The misspellings are found when
+    // process is called so the words in the speller must not change
+    // between calls to next_misspelling.  The default is taken from
+    // the "threads" option.
+    void set_num_threads(unsigned int n) {num_threads_ = n;}
    
     DocumentChecker();
     ~DocumentChecker();
     
   private:
+    DocumentChecker(const DocumentChecker &);
+    void operator=(const DocumentChecker &);
+
+    struct Worker;
+    void process_parallel(FilterChar * begin, FilterChar * end);
+
     CopyPtr<Filter> filter_;
     CopyPtr<Tokenizer> tokenizer_;
     void (* status_fun_)(void *, Token, int);
@@ -53,6 +70,12 @@ namespace acommon {
     Speller * speller_;
     Convert * conv_;
     FilterCharVector proc_str_;
+
+    unsigned int num_threads_;
+    bool parallel_;
+    Vector<Worker *> workers_;
+    Vector<Token> misspellings_;
+    unsigned int next_;
   };
 
   PosibErr<DocumentChecker *> new_document_checker(Speller *);
@@ -13,6 +13,7 @@
 #include "strtonum.hpp"
 #include "errors.hpp"
 #include "asc_ctype.hpp"
+#include "mem_report.hpp"
 
 #ifdef HAVE_LIBDL
 #  include <dlfcn.h>
@@ -26,7 +27,11 @@ namespace acommon {
     //if (handle) dlclose(handle);
   } 
 
-  Filter::Filter() {}
+  // The number of characters the fused filters are run over at once,
+  // small enough for the block to stay in the cache.
+  static const unsigned int fused_block_size = 4096;
+
+  Filter::Filter() : fused_(true) {}
 
   void Filter::add_filter(IndividualFilter * filter)
   {
@@ -48,13 +53,68 @@ namespace acommon {
       (*cur)->reset();
   }
 
+  void Filter::memory_usage(MemReport & r) const
+  {
+    for (Filters::const_iterator i = filters_.begin(); 
+         i != filters_.end(); ++i)
+      (*i)->memory_usage(r);
+  }
+
+  void IndividualFilter::memory_usage(MemReport & r) const
+  {
+    r.add(name(), 0);
+  }
+
   void Filter::process(FilterChar * & start, FilterChar * & stop)
   {
     Filters::iterator cur, end;
     cur = filters_.begin();
     end = filters_.end();
-    for (; cur != end; ++cur)
-      (*cur)->process(start, stop);
+    while (cur != end) {
+      Filters::iterator last = cur;
+      if (fused_)
+        while (last != end && (*last)->streaming()) ++last;
+      if (last - cur > 1) {
+        process_fused(cur, last, start, stop);
+        cur = last;
+      } else {
+        (*cur)->process(start, stop);
+        ++cur;
+      }
+    }
+  }
+
+  // Runs the streaming filters in [first, last) over one block of the
+  // string at a time instead of each over the whole string.  A block
+  // ends at a line break, or a space if a line is too long, which is
+  // temporarily replaced by a null to keep the guarantee that
+  // *stop == '\0'.
+  void Filter::process_fused(Filters::iterator first, Filters::iterator last,
+                             FilterChar * start, FilterChar * stop)
+  {
+    FilterChar * begin = start;
+    while (begin != stop) {
+      FilterChar * end = stop;
+      if ((unsigned)(stop - begin) > fused_block_size) {
+        end = begin + fused_block_size;
+        FilterChar * p = end;
+        while (p != stop && *p != '\n') ++p;
+        if ((unsigned)(p - end) > fused_block_size) {
+          p = end;
+          while (p != stop && *p != ' ' && *p != '\t' && *p != '\n') ++p;
+        }
+        end = p;
+      }
+      FilterChar::Chr c = end->chr;
+      end->chr = 0;
+      for (Filters::iterator cur = first; cur != last; ++cur) {
+        FilterChar * b = begin, * e = end;
+        (*cur)->process(b, e);
+        assert(b == begin && e == end);
+      }
+      end->chr = c;
+      begin = end;
+    }
   }
 
   void Filter::clear()
@@ -21,6 +21,7 @@ namespace acommon {
   class Config;
   class Speller;
   class IndividualFilter;
+  class MemReport;
   class StringList;
   struct ConfigModule;
 
@@ -32,6 +33,9 @@ namespace acommon {
     void reset();
     void process(FilterChar * & start, FilterChar * & stop);
     void add_filter(IndividualFilter * filter);
+    void memory_usage(MemReport &) const;
+    // if true neighbouring streaming filters are run in a single pass
+    void set_fused(bool f) {fused_ = f;}
     // setup the filter where the string list is the list of 
     // filters to use.
     Filter();
@@ -40,6 +44,9 @@ namespace acommon {
  private:
     typedef Vector<IndividualFilter *> Filters;
     Filters filters_;
+    bool fused_;
+    void process_fused(Filters::iterator first, Filters::iterator last,
+                       FilterChar * start, FilterChar * stop);
   };
 
   PosibErr<void> set_mode_from_extension(Config * config,
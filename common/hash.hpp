@@ -145,6 +145,7 @@ namespace acommon {
     const_iterator begin() const {return const_iterator(table_);}
     const_iterator end()   const {return const_iterator(table_end_,*table_end_);}
     size_type size() const  {return size_;}
+    size_type bucket_count() const {return table_size_;}
     bool      empty() const {return size_ + 1;}
     std::pair<iterator,bool> insert(const value_type &); 
     void erase(iterator);
@@ -16,6 +16,7 @@
 namespace acommon {
 
   class Config;
+  class MemReport;
 
   class FilterHandle {
   public:
@@ -80,19 +81,30 @@ namespace acommon {
     //
     virtual void process(FilterChar * & start, FilterChar * & stop) = 0;
 
+    // adds the memory used by the filter's state to the report, by
+    // default a line with just the name
+    virtual void memory_usage(MemReport &) const;
+
     virtual ~IndividualFilter() {}
 
     const char * name() const {return name_.str();}
     double order_num() const {return order_num_;}
+    bool streaming() const {return streaming_;}
 
     FilterHandle handle;
 
   protected:
 
-    IndividualFilter() : name_(0), order_num_(0.50) {}
+    IndividualFilter() : name_(0), order_num_(0.50), streaming_(false) {}
     
     String name_; // must consist of 'a-z|0-9'
     double order_num_; // between 0 and 1 exclusive
+
+    // Should be set to true by filters which always modify the string
+    // in place and give the same result no matter where the string
+    // is split on white space.  Such filters may be run together with
+    // their neighbours over one block of the string at a time.
+    bool streaming_;
   };
 
 }
@@ -9,6 +9,9 @@
 #include <string.h>
 #include <ctype.h>
 #include <dirent.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 // POSIX includes
 #ifdef __bsdi__
@@ -18,6 +21,8 @@
 #ifdef WIN32
 #  include <windows.h>
 #  include <winbase.h>
+#else
+#  include <unistd.h>
 #endif
 
 #include "iostream.hpp"
@@ -25,6 +30,7 @@
 #include "asc_ctype.hpp"
 #include "config.hpp"
 #include "errors.hpp"
+#include "file_util.hpp"
 #include "fstream.hpp"
 #include "getdata.hpp"
 #include "info.hpp"
@@ -70,6 +76,8 @@ namespace acommon {
 
   typedef Vector<DictExt> DictExtList;
 
+  class DirIndex;
+
   struct MDInfoListAll
   // this is in an invalid state if some of the lists
   // has data but others don't
@@ -81,6 +89,8 @@ namespace acommon {
     DictExtList    dict_exts;
     DictInfoList   dict_info_list;
     StringMap      dict_aliases;
+    DirIndex *     dir_index; // only set while filling the lists
+    MDInfoListAll() : dir_index(0) {}
     void clear();
     PosibErr<void> fill(Config *, StringList &);
     bool has_data() const {return module_info_list.head_ != 0;}
@@ -114,6 +124,135 @@ namespace acommon {
 
   static MDInfoListofLists md_info_list_of_lists;
 
+  /////////////////////////////////////////////////////////////////
+  //
+  // Directory Index
+  //
+
+  // The names of the files in the data and dictionary directories
+  // can be kept in the file given by the dict-index option so that
+  // a new process does not need to read the directories again.  A
+  // listing is only used if the modification time of the directory
+  // is the same as when it was read, and the directory was not
+  // modified in the same second it was read in.
+
+  struct DirListing
+  {
+    String dir;
+    time_t mtime;
+    time_t read_at;
+    Vector<String> names;
+  };
+
+  class DirIndex
+  {
+    String file_;
+    Vector<DirListing> dirs_;
+    bool changed_;
+  public:
+    DirIndex() : changed_(false) {}
+    void read(ParmStr file);
+    const DirListing * list(const char * dir);
+    void write();
+  };
+
+  static const char * const dir_index_header = "aspell dict index 1";
+
+  void DirIndex::read(ParmStr file)
+  {
+    file_ = file;
+    dirs_.clear();
+    changed_ = false;
+    if (file_.empty()) return;
+    FStream in;
+    if (in.open(file_, "r").get_err()) return;
+    String buf;
+    if (!in.getline(buf) || buf != dir_index_header) return;
+    bool ok = true;
+    while (ok && in.getline(buf)) {
+      if (strncmp(buf.str(), "dir ", 4) == 0) {
+        char * p = buf.mstr() + 4;
+        DirListing l;
+        l.mtime = strtoul(p, &p, 10);
+        l.read_at = strtoul(p, &p, 10);
+        if (*p != ' ') {ok = false; break;}
+        l.dir = p + 1;
+        dirs_.push_back(l);
+      } else if (strncmp(buf.str(), "file ", 5) == 0 && !dirs_.empty()) {
+        dirs_.back().names.push_back(buf.str() + 5);
+      } else {
+        ok = false;
+      }
+    }
+    if (!ok)
+      dirs_.clear(); // something is wrong with the file so ignore it
+  }
+
+  const DirListing * DirIndex::list(const char * dir)
+  {
+    struct stat st;
+    if (stat(dir, &st) != 0) return 0;
+    Vector<DirListing>::iterator l = dirs_.begin();
+    for (; l != dirs_.end(); ++l)
+      if (l->dir == dir) break;
+    if (l != dirs_.end() && l->mtime == st.st_mtime && l->mtime < l->read_at)
+      return &*l;
+
+    time_t now = time(0);
+    Dir d(opendir(dir));
+    if (d == 0) return 0;
+    if (l == dirs_.end()) {
+      dirs_.push_back(DirListing());
+      l = dirs_.end() - 1;
+      l->dir = dir;
+    }
+    l->mtime = st.st_mtime;
+    l->read_at = now;
+    l->names.clear();
+    struct dirent * entry;
+    while ( (entry = readdir(d)) != 0) {
+      const char * name = entry->d_name;
+      if (name[0] == '.' && (name[1] == '\0' || 
+                             (name[1] == '.' && name[2] == '\0')))
+        continue;
+      l->names.push_back(name);
+    }
+    changed_ = true;
+    return &*l;
+  }
+
+  void DirIndex::write()
+  {
+    if (file_.empty() || !changed_) return;
+    // other processes, or threads filling the lists for another
+    // config, may be writing the index at the same time so the
+    // temporary file name must be unique
+    String tmp = file_;
+#ifdef WIN32
+    tmp.printf(".%lu.%p.new", (unsigned long)GetCurrentProcessId(), this);
+#else
+    tmp.printf(".%d.%p.new", (int)getpid(), this);
+#endif
+    FStream out;
+    if (out.open(tmp, "w").get_err()) return;
+    out << dir_index_header << '\n';
+    for (Vector<DirListing>::const_iterator l = dirs_.begin(); 
+         l != dirs_.end(); ++l)
+    {
+      if (strchr(l->dir.str(), '\n')) continue;
+      out.printf("dir %lu %lu %s\n", (unsigned long)l->mtime,
+                 (unsigned long)l->read_at, l->dir.str());
+      for (Vector<String>::const_iterator i = l->names.begin(); 
+           i != l->names.end(); ++i)
+        if (!strchr(i->str(), '\n'))
+          out << "file " << *i << '\n';
+    }
+    out.close();
+    if (!rename_file(tmp, file_))
+      remove_file(tmp);
+    changed_ = false;
+  }
+
   /////////////////////////////////////////////////////////////////
   //
   // Utility functions declaration
@@ -178,12 +317,12 @@ namespace acommon {
     StringListEnumeration els = list_all.for_dirs.elements_obj();
     const char * dir;
     while ( (dir = els.next()) != 0) {
-      Dir d(opendir(dir));
-      if (d==0) continue;
+      const DirListing * l = list_all.dir_index->list(dir);
+      if (l == 0) continue;
     
-      struct dirent * entry;
-      while ( (entry = readdir(d)) != 0) {
-	const char * name = entry->d_name;
+      for (Vector<String>::const_iterator entry = l->names.begin();
+           entry != l->names.end(); ++entry) {
+	const char * name = entry->str();
 	const char * dot_loc = strrchr(name, '.');
 	unsigned int name_size = dot_loc == 0 ? strlen(name) :  dot_loc - name;
       
@@ -339,13 +478,13 @@ namespace acommon {
     els = list_all.dict_dirs.elements_obj();
     const char * dir;
     while ( (dir = els.next()) != 0) {
-      Dir d(opendir(dir));
-      if (d==0) continue;
+      const DirListing * l = list_all.dir_index->list(dir);
+      if (l == 0) continue;
     
-      struct dirent * entry;
-      while ( (entry = readdir(d)) != 0) {
-	const char * name = entry->d_name;
-	unsigned int name_size = strlen(name);
+      for (Vector<String>::const_iterator entry = l->names.begin();
+           entry != l->names.end(); ++entry) {
+	const char * name = entry->str();
+	unsigned int name_size = entry->size();
 
 	const DictExt * i = find_dict_ext(list_all.dict_exts, 
                                           ParmString(name, name_size));
@@ -517,6 +656,9 @@ namespace acommon {
                                      StringList & dirs)
   {
     PosibErr<void> err;
+    DirIndex index;
+    index.read(c->retrieve("dict-index"));
+    dir_index = &index;
 
     err = fill_dict_aliases(c);
     if (err.has_err()) goto RETURN_ERROR;
@@ -529,9 +671,12 @@ namespace acommon {
     err = dict_info_list.fill(*this, c);
     if (err.has_err()) goto RETURN_ERROR;
 
+    index.write();
+    dir_index = 0;
     return err;
 
   RETURN_ERROR:
+    dir_index = 0;
     clear();
     return err;
   }
@@ -21,6 +21,7 @@
 
 #ifdef USE_POSIX_MUTEX
 #  include <pthread.h>
+#  include <sched.h>
 #endif
 
 namespace acommon {
@@ -63,6 +64,70 @@ namespace acommon {
     void release() {if (lock_) lock_->unlock(); lock_ = NULL;}
     ~Lock() {if (lock_) lock_->unlock();}
   };
+
+  // Atomic operations for reference counts and for data which is read
+  // without holding a lock.  All of them are sequentially consistent.
+  // If the compiler does not provide atomic builtins a single global
+  // mutex is used instead, and without threads they are just ordinary
+  // operations.
+
+#if defined USE_POSIX_MUTEX && defined __GNUC__
+
+  template <typename T>
+  inline T atomic_load(T * p) {return __atomic_load_n(p, __ATOMIC_SEQ_CST);}
+  template <typename T>
+  inline void atomic_store(T * p, T v) {__atomic_store_n(p, v, __ATOMIC_SEQ_CST);}
+  template <typename T>
+  inline T atomic_inc(T * p) {return __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST);}
+  template <typename T>
+  inline T atomic_dec(T * p) {return __atomic_sub_fetch(p, 1, __ATOMIC_SEQ_CST);}
+  template <typename T>
+  inline T atomic_add(T * p, T v) {return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST);}
+  // increments the value unless it is zero, returns false if it was
+  template <typename T>
+  inline bool atomic_inc_not_zero(T * p) {
+    T v = __atomic_load_n(p, __ATOMIC_SEQ_CST);
+    while (v != 0) {
+      if (__atomic_compare_exchange_n(p, &v, v + 1, true, 
+                                      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        return true;
+    }
+    return false;
+  }
+  inline void yield_thread() {sched_yield();}
+
+#else
+
+#  ifdef USE_POSIX_MUTEX
+  extern Mutex atomic_ops_lock; // defined in cache.cpp
+#    define ATOMIC_LOCK LOCK(&atomic_ops_lock)
+  inline void yield_thread() {sched_yield();}
+#  else
+#    define ATOMIC_LOCK
+  inline void yield_thread() {}
+#  endif
+
+  template <typename T>
+  inline T atomic_load(T * p) {ATOMIC_LOCK; return *p;}
+  template <typename T>
+  inline void atomic_store(T * p, T v) {ATOMIC_LOCK; *p = v;}
+  template <typename T>
+  inline T atomic_inc(T * p) {ATOMIC_LOCK; return ++*p;}
+  template <typename T>
+  inline T atomic_dec(T * p) {ATOMIC_LOCK; return --*p;}
+  template <typename T>
+  inline T atomic_add(T * p, T v) {ATOMIC_LOCK; return *p += v;}
+  template <typename T>
+  inline bool atomic_inc_not_zero(T * p) {
+    ATOMIC_LOCK; 
+    if (*p == 0) return false; 
+    ++*p; 
+    return true;
+  }
+
+#  undef ATOMIC_LOCK
+
+#endif
 };
 
 #endif
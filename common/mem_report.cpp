@@ -0,0 +1,119 @@
+/* This file is part of The New Aspell
+ * Copyright (C) 2001 by Kevin Atkinson under the GNU LGPL
+ * license version 2.0 or 2.1.  You should have received a copy of the
+ * LGPL license along with this library if you did not you can find it
+ * at http://www.gnu.org/.                                              */
+
+#include <stdio.h>
+
+#include "settings.h"
+
+#include "mem_report.hpp"
+#include "mutable_container.hpp"
+#include "posib_err.hpp"
+
+#ifdef HAVE_MINCORE
+#  include <unistd.h>
+#  include <sys/mman.h>
+#endif
+
+namespace acommon {
+
+  void MemReport::begin(ParmStr name)
+  {
+    add(name, MemUsage());
+    open_.push_back(lines_.size() - 1);
+  }
+
+  void MemReport::end()
+  {
+    open_.pop_back();
+  }
+
+  void MemReport::add(ParmStr name, const MemUsage & usage)
+  {
+    lines_.push_back(Line());
+    Line & l = lines_.back();
+    l.name = name;
+    l.depth = open_.size();
+    l.usage = usage;
+    for (Vector<unsigned>::const_iterator i = open_.begin();
+         i != open_.end(); ++i)
+      lines_[*i].usage += usage;
+  }
+
+  void MemReport::add(ParmStr name, size_t heap, size_t mapped, size_t resident)
+  {
+    MemUsage u;
+    u.heap = heap;
+    u.mapped = mapped;
+    u.resident = resident;
+    add(name, u);
+  }
+
+  void MemReport::add_mapped(ParmStr name, const void * begin, size_t size)
+  {
+    add(name, 0, size, resident_size(begin, size));
+  }
+
+  MemUsage MemReport::total() const
+  {
+    MemUsage total;
+    for (Vector<Line>::const_iterator i = lines_.begin();
+         i != lines_.end(); ++i)
+      if (i->depth == 0) total += i->usage;
+    return total;
+  }
+
+  void MemReport::write(MutableContainer & out) const
+  {
+    char buf[128];
+    String line;
+    Vector<const String *> path;
+    for (Vector<Line>::const_iterator i = lines_.begin();
+         i != lines_.end(); ++i)
+    {
+      path.resize(i->depth);
+      path.push_back(&i->name);
+      line.clear();
+      for (unsigned j = 0; j != path.size(); ++j) {
+        if (j != 0) line += " > ";
+        line += *path[j];
+      }
+      snprintf(buf, sizeof(buf), ": heap %lu", (unsigned long)i->usage.heap);
+      line += buf;
+      if (i->usage.mapped) {
+        snprintf(buf, sizeof(buf), ", mapped %lu, resident %lu",
+                 (unsigned long)i->usage.mapped,
+                 (unsigned long)i->usage.resident);
+        line += buf;
+      }
+      out.add(line);
+    }
+  }
+
+  size_t resident_size(const void * begin, size_t size)
+  {
+#ifdef HAVE_MINCORE
+    if (size == 0) return 0;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t offset = (size_t)begin % page_size;
+    char * b = (char *)begin - offset;
+    size_t num_pages = (size + offset + page_size - 1) / page_size;
+    Vector<unsigned char> in_core(num_pages);
+    if (mincore(b, num_pages * page_size, &in_core.front()) != 0)
+      return size;
+    size_t res = 0;
+    for (size_t i = 0; i != num_pages; ++i)
+      if (in_core[i] & 1) res += page_size;
+    // the first and last page may only be partly used
+    if (in_core[0] & 1) res -= offset;
+    size_t tail = num_pages * page_size - size - offset;
+    if (in_core[num_pages - 1] & 1) res -= tail;
+    return res;
+#else
+    return size;
+#endif
+  }
+
+}
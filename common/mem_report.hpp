@@ -0,0 +1,62 @@
+/* This file is part of The New Aspell
+ * Copyright (C) 2001 by Kevin Atkinson under the GNU LGPL
+ * license version 2.0 or 2.1.  You should have received a copy of the
+ * LGPL license along with this library if you did not you can find it
+ * at http://www.gnu.org/.                                              */
+
+#ifndef ACOMMON_MEM_REPORT__HPP
+#define ACOMMON_MEM_REPORT__HPP
+
+#include <stddef.h>
+
+#include "parm_string.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace acommon {
+
+  class MutableContainer;
+
+  struct MemUsage {
+    size_t heap;     // bytes allocated
+    size_t mapped;   // bytes of memory mapped files
+    size_t resident; // bytes of the mapped ones currently in memory
+    MemUsage() : heap(0), mapped(0), resident(0) {}
+    void operator+= (const MemUsage & o) {
+      heap += o.heap; mapped += o.mapped; resident += o.resident;
+    }
+  };
+
+  // A report of the memory used by an object broken down by its
+  // parts.  Each object or part added is a line of the report.  The
+  // lines added between begin and end are the parts of the object
+  // begun and it shows their sum.  Each line is written with the
+  // names of the objects it is a part of, as in "speller > en: ...",
+  // so that no two lines are the same.
+  class MemReport {
+    struct Line {
+      String name;
+      unsigned depth;
+      MemUsage usage;
+    };
+    Vector<Line> lines_;
+    Vector<unsigned> open_; // the objects begun but not yet ended
+    void add(ParmStr name, const MemUsage &);
+  public:
+    void begin(ParmStr name);
+    void end();
+    void add(ParmStr name, size_t heap, size_t mapped = 0, size_t resident = 0);
+    // adds a memory mapped part
+    void add_mapped(ParmStr name, const void * begin, size_t size);
+    MemUsage total() const;
+    // adds a line of text for each line of the report
+    void write(MutableContainer &) const;
+  };
+
+  // Returns how many bytes of the memory mapped region are currently
+  // in memory, or size if it can not be determined.
+  size_t resident_size(const void * begin, size_t size);
+
+}
+
+#endif
@@ -45,7 +45,7 @@ public:
   ObjStack(size_t chunk_s = 1024, size_t align = sizeof(void *));
   ~ObjStack();
 
-  size_t calc_size();
+  size_t calc_size() const;
 
   void reset();
   void trim();
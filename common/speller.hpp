@@ -33,6 +33,7 @@ namespace acommon {
   class Tokenizer;
   class Filter;
   class DocumentChecker;
+  class MemReport;
 
   struct CheckInfo {
     const CheckInfo * next;
@@ -49,6 +50,14 @@ namespace acommon {
     short compound;
   };
 
+  // Holds all the per call state used by the reentrant versions of
+  // check and suggest.  Obtained from Speller::new_check_context and
+  // owned by the caller.
+  class CheckContext {
+  public:
+    virtual ~CheckContext() {}
+  };
+
   class Speller : public CanHaveError
   {
   private:
@@ -76,6 +85,13 @@ namespace acommon {
     // the setup class will take over for config
     virtual PosibErr<void> setup(Config *) = 0;
 
+    // returns a new speller, with a copy of the config, which shares
+    // the language, the main dictionaries and anything else that
+    // does not change with this one.  The personal and replacement
+    // word lists are loaded again and the session word list starts
+    // out empty.  Should be called only after this class is setup.
+    virtual PosibErr<Speller *> clone() const = 0;
+
     // sets up the tokenizer class
     // should be called only after this class is setup
     virtual void setup_tokenizer(Tokenizer *) = 0;
@@ -88,6 +104,18 @@ namespace acommon {
 
     virtual PosibErr<bool> check(MutableString) = 0;
 
+    // checks several words at once, the words are expected to be
+    // packed one after another, each followed by a null character,
+    // with sizes[i] the size of word i not counting the null.
+    // Bit i of result (result[i/8] & (1 << i%8)) is set if word i
+    // is correct, result must have room for (num + 7)/8 bytes.
+    // Returns the number of correct words.  check_info is not valid
+    // after a call to check_batch.
+    virtual PosibErr<unsigned int> check_batch(char * words, 
+                                               const unsigned int * sizes,
+                                               unsigned int num,
+                                               unsigned char * result) = 0;
+
     // these functions return information about the last word checked
     virtual const CheckInfo * check_info() = 0;
   
@@ -114,6 +142,41 @@ namespace acommon {
     virtual PosibErr<void> store_replacement(MutableString, 
 					     MutableString) = 0;
 
+    ////////////////////////////////////////////////////////////////
+    //
+    // Reentrant interface
+    //
+    // The methods above are NOT meant to be used by multiple threads.
+    // The methods below keep all per call state in the context
+    // passed in, including the conversion buffers, so several
+    // threads may check and suggest using the same speller and
+    // dictionaries at once as long as each thread has its own
+    // context.  No other method may be called while this is going
+    // on.  Strings are in the external encoding, a size of -1 means
+    // the string is null terminated.  The session and personal word
+    // lists are used but must not be changed while contexts are in
+    // use.
+    //
+
+    // must not be called while another thread is using the speller
+    virtual PosibErr<CheckContext *> new_check_context() = 0;
+
+    virtual PosibErr<bool> check(const char * word, int size, 
+                                 CheckContext *) = 0;
+    // same as above but the word is already in the internal encoding,
+    // it WILL be modified during the call
+    virtual PosibErr<bool> check(MutableString word, CheckContext *) = 0;
+    // returns information about the last word checked with the context
+    virtual const CheckInfo * check_info(CheckContext *) = 0;
+    // the word list returned is only valid until the next call to
+    // suggest with the same context, the elements are converted to
+    // the external encoding using the context
+    virtual PosibErr<const WordList *> suggest(const char * word, int size,
+                                               CheckContext *) = 0;
+
+    // adds the memory used by the speller and its parts to the report
+    virtual void memory_usage(MemReport &) const = 0;
+
     virtual ~Speller();
 
   };
@@ -126,6 +189,9 @@ namespace acommon {
 
   PosibErr<Speller *> new_speller(Config * c);
 
+  // creates a new speller from an existing one, see Speller::clone
+  PosibErr<Speller *> clone_speller(const Speller * m);
+
 }
 
 #endif
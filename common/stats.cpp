@@ -0,0 +1,127 @@
+/* This file is part of The New Aspell
+ * Copyright (C) 2001 by Kevin Atkinson under the GNU LGPL
+ * license version 2.0 or 2.1.  You should have received a copy of the
+ * LGPL license along with this library if you did not you can find it
+ * at http://www.gnu.org/.                                              */
+
+#include <stdio.h>
+
+#include "stats.hpp"
+#include "mutable_container.hpp"
+#include "posib_err.hpp"
+
+namespace acommon {
+
+  bool stats_enabled = false;
+  unsigned long stats[STAT_SIZE];
+
+  static const char * const stat_names[STAT_SIZE] = {
+    "check",
+    "check-cache-hit",
+    "check-cache-miss",
+    "title-retry",
+    "run-together-split",
+    "dict-lookup",
+    "dict-probe",
+    "dict-duplicate",
+    "stem-lookup",
+    "prefix-tried",
+    "prefix-matched",
+    "suffix-tried",
+    "suffix-matched",
+    "doc-token",
+    "doc-byte",
+    "filter-usec"
+  };
+
+  void enable_stats(bool on)
+  {
+    atomic_store(&stats_enabled, on);
+  }
+
+  void reset_stats()
+  {
+    for (int i = 0; i != STAT_SIZE; ++i)
+      atomic_store(&stats[i], 0ul);
+  }
+
+  void get_stats(MutableContainer & out)
+  {
+    char buf[64];
+    for (int i = 0; i != STAT_SIZE; ++i) {
+      snprintf(buf, sizeof(buf), "%s: %lu",
+               stat_names[i], atomic_load(&stats[i]));
+      out.add(buf);
+    }
+  }
+
+  TraceHook trace_hook = 0;
+  void * trace_hook_data = 0;
+
+  void set_trace_hook(TraceHook hook, void * data)
+  {
+    // clearing the hook first only keeps the new hook from being
+    // called with the old data, see stats.hpp
+    atomic_store(&trace_hook, (TraceHook)0);
+    atomic_store(&trace_hook_data, data);
+    atomic_store(&trace_hook, hook);
+  }
+
+  static FILE * trace_file = 0;
+  static Mutex trace_file_lock;
+
+  // Does not use its data, so set_trace_file may be called at any
+  // time.
+  static void trace_to_file(void *, const char * event,
+                            ParmStr what, long value)
+  {
+    LOCK(&trace_file_lock);
+    // the hook may have been removed and the file closed since the
+    // hook was called
+    if (!trace_file) return;
+    fputs(event, trace_file);
+    putc(' ', trace_file);
+    fwrite(what.str(), 1, what.size(), trace_file);
+    fprintf(trace_file, " %ld\n", value);
+  }
+
+  bool set_trace_file(const char * file)
+  {
+    FILE * f = 0;
+    if (file) {
+      f = fopen(file, "w");
+      if (!f) return false;
+    }
+    set_trace_hook(0, 0);
+    LOCK(&trace_file_lock);
+    if (trace_file) fclose(trace_file);
+    trace_file = f;
+    if (f) set_trace_hook(trace_to_file, 0);
+    return true;
+  }
+
+  extern "C"
+  void aspell_enable_stats(int on)
+  {
+    enable_stats(on);
+  }
+
+  extern "C"
+  void aspell_reset_stats()
+  {
+    reset_stats();
+  }
+
+  extern "C"
+  void aspell_get_stats(MutableContainer * lst)
+  {
+    get_stats(*lst);
+  }
+
+  extern "C"
+  int aspell_set_trace_file(const char * file)
+  {
+    return set_trace_file(file);
+  }
+
+}
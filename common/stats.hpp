@@ -0,0 +1,89 @@
+/* This file is part of The New Aspell
+ * Copyright (C) 2001 by Kevin Atkinson under the GNU LGPL
+ * license version 2.0 or 2.1.  You should have received a copy of the
+ * LGPL license along with this library if you did not you can find it
+ * at http://www.gnu.org/.                                              */
+
+#ifndef ACOMMON_STATS__HPP
+#define ACOMMON_STATS__HPP
+
+#include "lock.hpp"
+#include "parm_string.hpp"
+
+namespace acommon {
+
+  class MutableContainer;
+
+  // Counters of the work done when checking words and documents.
+  // They are global and shared by all spellers.  Counting is off by
+  // default in which case a counter costs no more than a test of
+  // stats_enabled, counters inside loops are kept in a local
+  // variable and added once when done.
+
+  enum StatId {
+    STAT_CHECK,                // words checked, not counting suggest's checks
+    STAT_CHECK_CACHE_HIT,      // ... answered by the check cache
+    STAT_CHECK_CACHE_MISS,     // ... looked up in it but not found
+    STAT_TITLE_RETRY,          // retried in title case
+    STAT_RUN_TOGETHER_SPLIT,   // places a run-together word was split at
+    STAT_DICT_LOOKUP,          // lookups in read only dictionaries
+    STAT_DICT_PROBE,           // hash table entries compared
+    STAT_DICT_DUPLICATE,       // duplicate entries stepped over
+    STAT_STEM_LOOKUP,          // lookups of a word or root by the affix code
+    STAT_PREFIX_TRIED,         // prefix entries tried
+    STAT_PREFIX_MATCHED,       // ... whose conditions were met
+    STAT_SUFFIX_TRIED,         // suffix entries tried
+    STAT_SUFFIX_MATCHED,       // ... whose conditions were met
+    STAT_DOC_TOKEN,            // words found by document checkers
+    STAT_DOC_BYTE,             // bytes given to document checkers
+    STAT_FILTER_USEC,          // microseconds spent filtering documents
+    STAT_SIZE
+  };
+
+  // Only changed by enable_stats, which should be called before
+  // the counters are needed.  Use atomic_load to read it as any
+  // thread may be counting.
+  extern bool stats_enabled;
+  extern unsigned long stats[STAT_SIZE];
+
+  static inline void stat_add(StatId id, unsigned long n = 1)
+  {
+    if (atomic_load(&stats_enabled)) atomic_add(&stats[id], n);
+  }
+
+  void enable_stats(bool);
+  void reset_stats();
+  // Adds a "name: value" line for each counter.
+  void get_stats(MutableContainer &);
+
+  // A trace hook is called for individual events, such as a word
+  // being checked, with a short name of the event, the word or other
+  // object it is about, and a number whose meaning depends on the
+  // event.  The hook may be called from several threads at once.
+  typedef void (* TraceHook)(void * data, const char * event,
+                             ParmStr what, long value);
+
+  // Use atomic_load to read these, they are set by set_trace_hook.
+  extern TraceHook trace_hook;
+  extern void * trace_hook_data;
+
+  // The hook and its data are read separately by trace, so a thread
+  // checking at the same time may call the old hook with the new
+  // data.  Only change a hook which uses its data while no thread is
+  // checking.
+  void set_trace_hook(TraceHook, void * data);
+
+  // Sets a hook that writes a line for each event to file, or
+  // removes the hook if file is null.  Returns false if the file
+  // can not be opened.
+  bool set_trace_file(const char * file);
+
+  static inline void trace(const char * event, ParmStr what, long value)
+  {
+    TraceHook hook = atomic_load(&trace_hook);
+    if (hook) (*hook)(atomic_load(&trace_hook_data), event, what, value);
+  }
+
+}
+
+#endif
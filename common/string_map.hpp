@@ -115,6 +115,12 @@ public:
   unsigned int size() const {return lookup_.size();}
   bool empty() const {return lookup_.empty();}
 
+  // the approximate amount of memory used
+  size_t calc_size() const {
+    return lookup_.bucket_count() * sizeof(void *) 
+      + lookup_.size() * sizeof(Lookup::Node) + buffer_.calc_size();
+  }
+
 };
 
 StringMap * new_string_map();
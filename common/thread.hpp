@@ -0,0 +1,65 @@
+// File: thread.hpp
+//
+// Copyright (c) 2011
+// Kevin Atkinson
+//
+// Permission to use, copy, modify, distribute and sell this software
+// and its documentation for any purpose is hereby granted without
+// fee, provided that the above copyright notice appear in all copies
+// and that both that copyright notice and this permission notice
+// appear in supporting documentation.  Kevin Atkinson makes no
+// representations about the suitability of this software for any
+// purpose.  It is provided "as is" without express or implied
+// warranty.
+
+#ifndef ACOMMON_THREAD__HPP
+#define ACOMMON_THREAD__HPP
+
+#include "settings.h"
+
+#ifdef USE_POSIX_MUTEX
+#  include <pthread.h>
+#endif
+
+namespace acommon {
+
+  // A minimal wrapper around a thread.  If threads are not supported,
+  // or the thread can not be created, the function is simply run in
+  // the calling thread by start.
+
+#ifdef USE_POSIX_MUTEX
+  class Thread {
+    pthread_t t_;
+    bool running_;
+  private:
+    Thread(const Thread &);
+    void operator=(const Thread &);
+  public:
+    Thread() : running_(false) {}
+    ~Thread() {join();}
+    void start(void * (* fun)(void *), void * data) {
+      if (pthread_create(&t_, 0, fun, data) == 0)
+        running_ = true;
+      else
+        (*fun)(data);
+    }
+    void join() {
+      if (running_) {pthread_join(t_, 0); running_ = false;}
+    }
+  };
+#else
+  class Thread {
+  private:
+    Thread(const Thread &);
+    void operator=(const Thread &);
+  public:
+    Thread() {}
+    ~Thread() {}
+    void start(void * (* fun)(void *), void * data) {(*fun)(data);}
+    void join() {}
+  };
+#endif
+
+}
+
+#endif
@@ -4,6 +4,8 @@
 // license along with this library if you did not you can find
 // it at http://www.gnu.org/.
 
+#include <string.h>
+
 #include "tokenizer.hpp"
 #include "convert.hpp"
 
@@ -14,11 +16,24 @@ namespace acommon
     : word_begin(0), word_end(0), end(0), 
       begin_pos(0), end_pos(0),
       conv_(0) 
-  {}
+  {
+    memset(char_class_, 0, sizeof(char_class_));
+  }
 
   Tokenizer::~Tokenizer()
   {}
 
+  void Tokenizer::compile_char_types()
+  {
+    for (int i = 0; i != 256; ++i) {
+      const CharType & t = char_type_[i];
+      char_class_[i] = ((t.word   ? WORD   : 0) |
+                        (t.begin  ? BEGIN  : 0) |
+                        (t.middle ? MIDDLE : 0) |
+                        (t.end    ? END    : 0));
+    }
+  }
+
   void Tokenizer::reset (FilterChar * begin, FilterChar * end) 
   {
     bool can_encode = conv_->encode(begin, end, buf_);
@@ -38,14 +38,23 @@ namespace acommon {
     
     virtual bool advance() = 0; // returns false if there is nothing left
 
+    // character classes as bit flags, so that a single table lookup
+    // can answer several of the questions below
+    enum {WORD = 1, BEGIN = 2, MIDDLE = 4, END = 8};
+    unsigned char char_class(unsigned char c) const
+      {return char_class_[c];}
+
     bool is_begin(unsigned char c) const
-      {return char_type_[c].begin;}
+      {return char_class_[c] & BEGIN;}
     bool is_middle(unsigned char c) const
-      {return char_type_[c].middle;}
+      {return char_class_[c] & MIDDLE;}
     bool is_end(unsigned char c) const
-      {return char_type_[c].end;}
+      {return char_class_[c] & END;}
     bool is_word(unsigned char c) const
-      {return char_type_[c].word;}
+      {return char_class_[c] & WORD;}
+
+    // must be called after char_type_ is filled in
+    void compile_char_types();
 
   public: // but don't use
     // The speller class is expected to fill these members in
@@ -58,6 +67,7 @@ namespace acommon {
     };
     
     CharType char_type_[256];
+    unsigned char char_class_[256]; // compiled form of char_type_
     Convert * conv_;
     FilterCharVector buf_;
   };
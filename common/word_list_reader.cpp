@@ -0,0 +1,185 @@
+/* This file is part of The New Aspell
+ * Copyright (C) 2001 by Kevin Atkinson under the GNU LGPL
+ * license version 2.0 or 2.1.  You should have received a copy of the
+ * LGPL license along with this library if you did not you can find it
+ * at http://www.gnu.org/.                                              */
+
+#include <string.h>
+
+#include "settings.h"
+
+#include "word_list_reader.hpp"
+#include "errors.hpp"
+
+#include "gettext.h"
+
+//
+// The formats are those written by prog/prezip.c and prog/compress.c
+// and are decoded in the same way as those programs do.
+//
+// word-list-compress (.cwl):
+//   Each word is a byte with the length of the prefix it shares with
+//   the previous word plus one, or a 0 byte followed by that length
+//   if it is larger than 31, followed by the rest of the word.  The
+//   first byte is thus always 0x01.
+//
+// prezip (.pz):
+//   <data> ::= 0x02 <line>+ 0x1F 0xFF
+//   <line> ::= <prefix> <rest>*
+//   <prefix> ::= 0x00..0x1D | 0x1E 0xFF* 0x00..0xFE
+//   <rest> ::= 0x20..0xFF | <escape>
+//   <escape> ::= 0x1F 0x20..0x3F
+//   The prefix length is the sum of the bytes in <prefix> and is
+//   computed before unescaping.  Several <data> may follow each other.
+//
+
+namespace acommon {
+
+  void WordListReader::add(ParmStr file)
+  {
+    files_.push_back(file);
+  }
+
+  bool WordListReader::fill()
+  {
+    if (!file_) return false;
+    size_t s = fread(buf_, 1, buf_size, file_);
+    pos_ = buf_;
+    end_ = buf_ + s;
+    return s != 0;
+  }
+
+  void WordListReader::close()
+  {
+    if (file_ && own_) fclose(file_);
+    file_ = 0;
+  }
+
+  PosibErr<bool> WordListReader::open_next()
+  {
+    if (next_file_ == files_.size()) return false;
+    file_name_ = files_[next_file_++];
+    if (file_name_ == "-") {
+      file_ = stdin;
+      own_ = false;
+    } else {
+      file_ = fopen(file_name_.str(), "rb");
+      if (!file_) return make_err(cant_read_file, file_name_);
+      own_ = true;
+    }
+    pos_ = end_ = buf_;
+    done_ = false;
+    cur_.clear();
+    int c = get();
+    if (c == 2) {
+      format_ = Prezip;
+    } else {
+      format_ = c == 1 ? Cwl : Plain;
+      if (c != EOF) unget();
+    }
+    return true;
+  }
+
+  PosibErrBase WordListReader::corrupt(const char * what)
+  {
+    return make_err(bad_file_format, file_name_,
+                    what ? what : _("The compressed data is corrupt."));
+  }
+
+  PosibErr<const char *> WordListReader::next()
+  {
+    for (;;) {
+      if (!file_) {
+        RET_ON_ERR_SET(open_next(), bool, opened);
+        if (!opened) return 0;
+      }
+      PosibErr<const char *> line = format_ == Plain  ? next_plain()
+                                  : format_ == Cwl    ? next_cwl()
+                                  :                     next_prezip();
+      if (line.has_err() || line.data) return line;
+      close();
+    }
+  }
+
+  PosibErr<const char *> WordListReader::next_plain()
+  {
+    if (pos_ == end_ && !fill()) return 0;
+    cur_.clear();
+    for (;;) {
+      const char * nl = (const char *)memchr(pos_, '\n', end_ - pos_);
+      if (nl) {
+        cur_.append(pos_, nl - pos_);
+        pos_ = nl + 1;
+        break;
+      }
+      cur_.append(pos_, end_ - pos_);
+      pos_ = end_;
+      if (!fill()) break;
+    }
+    return cur_.str();
+  }
+
+  PosibErr<const char *> WordListReader::next_cwl()
+  {
+    int c = get();
+    if (c == EOF) return 0;
+    if (c == 0) c = get();
+    --c;
+    if (c < 0 || c > (int)cur_.size()) return corrupt();
+    cur_.resize(c);
+    while (c = get(), c > 32)
+      cur_.append((char)c);
+    if (c != EOF) unget();
+    return cur_.str();
+  }
+
+  PosibErr<const char *> WordListReader::next_prezip()
+  {
+    int c;
+  loop:
+    if (done_) {
+      // another stream may follow the end of the last one
+      c = get();
+      if (c == EOF) return 0;
+      if (c != 2) return corrupt();
+      done_ = false;
+      cur_.clear();
+    }
+    c = get();
+    if (c == EOF) return corrupt(_("Unexpected end of file."));
+    size_t prefix = c;
+    if (c == 30) {
+      while (c = get(), c == 255) prefix += 255;
+      if (c == EOF) return corrupt(_("Unexpected end of file."));
+      prefix += c;
+    }
+    if (prefix > cur_.size()) return corrupt();
+    cur_.resize(prefix);
+    while (c = get(), c > 30)
+      cur_.append((char)c);
+    if (c != EOF) unget();
+    line_.clear();
+    const char * w = cur_.str(), * end = w + cur_.size();
+    for (; w != end; ++w) {
+      if (*w != 31) {
+        line_.append(*w);
+      } else {
+        if (w + 1 == end) return corrupt();
+        unsigned char ch = *++w;
+        if (32 <= ch && ch < 64) {
+          line_.append((char)(ch - 32));
+        } else if (ch == 255 && w + 1 == end) {
+          done_ = true;
+        } else {
+          return corrupt();
+        }
+      }
+    }
+    if (!done_ && c == EOF) return corrupt(_("Unexpected end of file."));
+    // the end of the stream may follow the last word in which case
+    // it has no line of its own
+    if (done_ && line_.empty()) goto loop;
+    return line_.str();
+  }
+
+}
@@ -0,0 +1,83 @@
+/* This file is part of The New Aspell
+ * Copyright (C) 2001 by Kevin Atkinson under the GNU LGPL
+ * license version 2.0 or 2.1.  You should have received a copy of the
+ * LGPL license along with this library if you did not you can find it
+ * at http://www.gnu.org/.                                              */
+
+#ifndef ACOMMON_WORD_LIST_READER__HPP
+#define ACOMMON_WORD_LIST_READER__HPP
+
+#include <stdio.h>
+
+#include "parm_string.hpp"
+#include "posib_err.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace acommon {
+
+  // Reads the lines of one or more word lists in turn.  Each list may
+  // be plain text, or compressed with prezip (.pz) or
+  // word-list-compress (.cwl) in which case it is decompressed as it
+  // is read, so a compressed list can be given directly rather than
+  // piped through the decompressor.  The format is detected from the
+  // first byte of each list.
+
+  class WordListReader {
+  public:
+    enum Format {Plain, Cwl, Prezip};
+
+    WordListReader() : file_(0), own_(false), next_file_(0) {}
+    ~WordListReader() {close();}
+
+    // adds a file to read after the ones already added, "-" means
+    // standard input
+    void add(ParmStr file);
+
+    // returns the next line without the line break, or 0 when all
+    // the lists were read
+    PosibErr<const char *> next();
+
+    // the format of the list currently being read
+    Format format() const {return format_;}
+
+  private:
+    WordListReader(const WordListReader &);
+    void operator=(const WordListReader &);
+
+    static const unsigned int buf_size = 64*1024;
+
+    Vector<String> files_;
+    FILE * file_;
+    bool own_;
+    unsigned int next_file_;
+    String file_name_;
+    Format format_;
+    bool done_;     // if the end of a prezip stream was reached
+
+    char buf_[buf_size];
+    const char * pos_;
+    const char * end_;
+
+    String cur_;    // the current line, escaped for prezip
+    String line_;   // the current line unescaped
+
+    int get() {
+      if (pos_ == end_ && !fill()) return EOF;
+      return (unsigned char)*pos_++;
+    }
+    void unget() {--pos_;}
+    bool fill();
+    void close();
+    PosibErr<bool> open_next();
+    PosibErrBase corrupt(const char * what = 0);
+
+    // these return the next line of the current list or 0 at its end
+    PosibErr<const char *> next_plain();
+    PosibErr<const char *> next_cwl();
+    PosibErr<const char *> next_prezip();
+  };
+
+}
+
+#endif
@@ -0,0 +1,50 @@
+#
+# Embeds the filter mode files (*.amf) given on the command line into
+# gen/static_modes.src.cpp so that the modes which come with Aspell
+# do not have to be searched for and read at run time.
+#
+
+#mask characters which can not appear as is in a C string
+sub prep_str($)
+{
+  local $_ = $_[0];
+  s/([\"\\])/\\$1/g;
+  s/\t/\\t/g;
+  s/([^\x20-\x7e])/sprintf("\\%03o",ord($1))/ge;
+  return $_;
+}
+
+open(STATICMODES, ">gen/static_modes.src.cpp")
+  or die "cant generate static mode description\n";
+printf STATICMODES "/*File generated during build\n".
+                   "  Automatically generated file\n*/\n";
+printf STATICMODES "\n  static const StaticMode static_modes[] = {\n";
+
+%modes=();
+$firstmode = 1;
+while ($filename=shift) {
+  $modename=$filename;
+  $modename=~s/\.amf$//;
+  $modename=~s/[^\/]*\///g;
+  $modename=lc $modename;
+  ( exists $modes{$modename}) &&
+   (printf STDERR "mode allready defined $modename($filename); ignored;\n") && next;
+  ( open MODEFILE,"<$filename") ||
+   (printf STDERR "can't open `$filename'; ignored;\n") && next;
+  $modes{$modename}=1;
+  ( $firstmode != 1 ) && ( printf STATICMODES ",\n" );
+  $firstmode = 0;
+  printf STATICMODES "    {\"$modename\",\n";
+  while (<MODEFILE>) {
+    chomp;
+    print STATICMODES "      \"".prep_str($_)."\\n\"\n";
+  }
+  printf STATICMODES "    }";
+  close MODEFILE;
+}
+
+printf STATICMODES "\n  };\n";
+printf STATICMODES "\n  const unsigned int static_modes_size = ".
+                   "sizeof(static_modes)/sizeof(StaticMode);\n";
+
+close STATICMODES;
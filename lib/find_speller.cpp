@@ -485,6 +485,16 @@ namespace acommon {
     return m.release();
   }
 
+  PosibErr<Speller *> clone_speller(const Speller * m0)
+  {
+    RET_ON_ERR_SET(m0->clone(), Speller *, m1);
+    StackPtr<Speller> m(m1);
+
+    RET_ON_ERR(reload_filters(m));
+
+    return m.release();
+  }
+
   void delete_speller(Speller * m) 
   {
     SpellerLtHandle h = ((Speller *)(m))->lt_handle();
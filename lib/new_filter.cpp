@@ -76,6 +76,7 @@ namespace acommon
     bool cache_key_eq(const String & okey) const {
       return name == okey;
     }
+    const char * cache_key_str() const {return name.str();}
     ConfigFilterModule() : in_option(0) {}
     ~ConfigFilterModule();
     bool in_option;
@@ -128,6 +129,7 @@ namespace acommon
     StackPtr<IndividualFilter> ifilter;
 
     filter.clear();
+    filter.set_fused(config->retrieve_bool("fuse-filters"));
 
     while ((filter_name = els.next()) != 0) {
       //fprintf(stderr, "Loading %s ... \n", filter_name);
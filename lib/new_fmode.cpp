@@ -15,6 +15,7 @@
 #include "cache-t.hpp"
 #include "string.hpp"
 #include "vector.hpp"
+#include "hash-t.hpp"
 #include "config.hpp"
 #include "errors.hpp"
 #include "filter.hpp"
@@ -32,6 +33,17 @@
 
 namespace acommon {
 
+  // The mode files which come with Aspell are compiled in so that
+  // they do not need to be searched for when a mode is selected.  A
+  // mode file of the same name in the filter path takes precedence.
+
+  struct StaticMode {
+    const char * name;
+    const char * data;
+  };
+
+#include "static_modes.src.cpp"
+
   class FilterMode {
   public:
     class MagicString {
@@ -39,7 +51,6 @@ namespace acommon {
       MagicString(const String & mode) : mode_(mode), fileExtensions() {}
       MagicString(const String & magic, const String & mode)
         : magic_(magic), mode_(mode) {} 
-      bool matchFile(FILE * in, const String & ext);
       static PosibErr<bool> testMagic(FILE * seekIn, String & magic, const String & mode);
       void addExtension(const String & ext) { fileExtensions.push_back(ext); }
       bool hasExtension(const String & ext);
@@ -53,6 +64,7 @@ namespace acommon {
       }
       const String & magic() const { return magic_; }
       const String & magicMode() const { return mode_; }
+      const Vector<String> & extensions() const { return fileExtensions; }
       ~MagicString() {}
     private:
       String magic_;
@@ -63,12 +75,12 @@ namespace acommon {
     FilterMode(const String & name);
     PosibErr<bool> addModeExtension(const String & ext, String toMagic);
     PosibErr<bool> remModeExtension(const String & ext, String toMagic);
-    bool lockFileToMode(const String & fileName,FILE * in = NULL);
+    const Vector<MagicString> & magic() const { return magicKeys; }
     const String & modeName() const;
     void setDescription(const String & desc) {desc_ = desc;}
     const String & getDescription() const {return desc_;}
     PosibErr<void> expand(Config * config);
-    PosibErr<void> build(FStream &, int line = 1, 
+    PosibErr<void> build(IStream &, int line = 1, 
                          const char * fname = "mode file");
 
     ~FilterMode();
@@ -93,10 +105,15 @@ namespace acommon {
     typedef Config CacheConfig;
     typedef String CacheKey;
     String key;
+    // maps each file extension to the first mode which lists it
+    hash_map<String, unsigned> ext_index;
     static PosibErr<FilterModeList *> get_new(const String & key, const Config *);
+    void index_extensions();
+    const FilterMode * find_by_extension(ParmStr fileName) const;
     bool cache_key_eq(const String & okey) const {
       return key == okey;
     }
+    const char * cache_key_str() const {return key.str();}
   };
 
   class ModeNotifierImpl : public Notifier
@@ -207,58 +224,6 @@ namespace acommon {
     return false;
   }
 
-  bool FilterMode::lockFileToMode(const String & fileName,FILE * in) {
-
-    Vector<unsigned int> extStart;
-    int first_point = fileName.size();
-
-    while ( first_point > 0 ) {
-      while (    ( --first_point >= 0 )
-              && ( fileName[first_point] != '.' ) ) {
-      }
-      if (    ( first_point >= 0 )
-           && ( fileName[first_point] == '.' ) ) {
-        extStart.push_back(first_point + 1);
-      }
-    }
-    if ( extStart.size() < 1 )  {
-      return false;
-    }
-
-    bool closeFile = false;
-
-    if ( in == NULL ) {
-      in = fopen(fileName.str(),"rb");
-      closeFile= true;
-    }
-    for ( Vector<unsigned int>::iterator extSIt = extStart.begin() ;
-          extSIt != extStart.end() ; extSIt ++ ) {
-    
-      String ext(fileName);
-
-      ext.erase(0,*extSIt);
-      for ( Vector<MagicString>::iterator it = magicKeys.begin() ;
-            it != magicKeys.end() ; it++ ) {
-        PosibErr<bool> magicMatch = it->matchFile(in,ext);
-        if (    magicMatch 
-             || magicMatch.has_err() ) {
-          if ( closeFile ) {
-            fclose ( in );
-          }
-          if ( magicMatch.has_err() ) {
-            magicMatch.ignore_err();
-            return false;
-          }
-          return true;
-        }
-      }
-    }
-    if ( closeFile ) {
-      fclose(in);
-    }
-    return false;
-  }
-
   const String & FilterMode::modeName() const {
     return name_;
   }
@@ -288,30 +253,6 @@ namespace acommon {
   }
 
 
-  bool FilterMode::MagicString::matchFile(FILE * in,const String & ext) {
-
-    Vector<String>::iterator extIt;
-
-    for ( extIt = fileExtensions.begin() ; 
-          extIt != fileExtensions.end() ; extIt ++ ) {
-      if ( *extIt == ext ) {
-        break;
-      }
-    }
-    if ( extIt == fileExtensions.end() ) {
-      return false;
-    }
-
-    PosibErr<bool> pe = testMagic(in,magic_,mode_);
-
-    if ( pe.has_err() ) {
-      pe.ignore_err();
-      return false;
-    }
-    return true;
-  }
-
-
   PosibErr<bool> FilterMode::MagicString::testMagic(FILE * seekIn,String & magic, const String & mode) {
 
 #ifdef USE_POSIX_REGEX
@@ -446,7 +387,7 @@ namespace acommon {
     return no_err;  
   }
 
-  PosibErr<void> FilterMode::build(FStream & toParse, int line0, const char * fname) {
+  PosibErr<void> FilterMode::build(IStream & toParse, int line0, const char * fname) {
 
     String buf;
     DataPair dp;
@@ -480,6 +421,194 @@ namespace acommon {
     return no_err;
   }
 
+  static PosibErr<void> read_mode(IStream & toParse, const String & possMode,
+                                  const String & possModeFile,
+                                  FilterMode & collect)
+  {
+    String buf;
+    DataPair dp;
+
+    bool get_sucess = getdata_pair(toParse, dp, buf);
+    
+    to_lower(dp.key);
+    to_lower(dp.value);
+    if (    !get_sucess
+         || ( dp.key != "mode" ) 
+         || ( dp.value != possMode.str() ) )
+      return make_err(expect_mode_key,"mode").with_file(possModeFile, dp.line_num);
+
+    get_sucess = getdata_pair(toParse, dp, buf);
+    to_lower(dp.key);
+    if (    !get_sucess
+         || ( dp.key != "aspell" )
+         || ( dp.value == NULL )
+         || ( *(dp.value) == '\0' ) )
+      return make_err(mode_version_requirement).with_file(possModeFile, dp.line_num);
+
+#ifdef FILTER_VERSION_CONTROL
+    PosibErr<void> peb = check_version(dp.value.str);
+    if (peb.has_err()) return peb.with_file(possModeFile, dp.line_num);
+#endif
+    
+    while ( getdata_pair(toParse,dp,buf) ) {
+      to_lower(dp.key);
+      if (   ( dp.key == "desc" ) 
+          || ( dp.key == "description" ) ) 
+      {
+        unescape(dp.value);
+        collect.setDescription(dp.value);
+        break;
+      }
+      if ( dp.key == "magic" ) {
+
+        char * regbegin = dp.value;
+
+        while (    regbegin
+                && ( *regbegin != '/' ) ) {
+          regbegin++;
+        }
+        if (    ( regbegin == NULL )
+             || ( *regbegin == '\0' ) 
+             || ( *(++regbegin) == '\0' ) )
+          return make_err(missing_magic_expression).with_file(possModeFile, dp.line_num);
+        
+        char * regend = regbegin;
+        bool prevslash = false;
+
+        while (    regend
+                && ( *regend != '\0' )
+                && (    prevslash
+                     || ( * regend != '/' ) ) )  {
+          if ( *regend == '\\' ) {
+            prevslash = !prevslash;
+          }
+          else {
+            prevslash = false;
+          }
+          regend ++ ;
+        }
+        if ( regend == regbegin )
+          return make_err(missing_magic_expression).with_file(possModeFile, dp.line_num);
+
+        char swap = *regend;
+
+        *regend = '\0';
+        
+        String magic(regbegin);
+        
+        *regend = swap;
+
+        unsigned int extCount = 0;
+
+        while ( *regend != '\0' ) {
+          regend ++;
+          extCount ++;
+          regbegin = regend;
+          while (    ( *regend != '/' ) 
+                  && ( *regend != '\0' ) ) {
+            regend++;
+          }
+          if ( regend == regbegin ) 
+          {
+            char charCount[64];
+            sprintf(&charCount[0],"%li",(long)(regbegin - (char *)dp.value));
+            return  make_err(empty_file_ext,charCount).with_file(possModeFile,dp.line_num);
+          }
+
+          bool remove = false;
+          bool add = true;
+
+          if ( *regbegin == '+' ) {
+            regbegin++;
+          }
+          else if ( *regbegin == '-' ) {
+            add = false;
+            remove = true;
+            regbegin++;
+          }
+          if ( regend == regbegin ) 
+          {
+            char charCount[64];
+            sprintf(&charCount[0],"%li",(long)(regbegin - (char *)dp.value));
+            return  make_err(empty_file_ext,charCount).with_file(possModeFile,dp.line_num);
+          }
+          swap = *regend;
+          *regend = '\0';
+          
+          String ext(regbegin);
+
+          *regend = swap;
+
+          // partially unescape magic
+          
+          char * dest = magic.mstr();
+          const char * src  = magic.mstr();
+          while (*src) {
+            if ((*src == '\\' && src[1] == '/') || src[1] == '#')
+              ++src;
+            *dest++ = *src++;
+          }
+          magic.resize(dest - magic.mstr());
+
+          PosibErr<bool> pe;
+
+          if ( remove )
+            pe = collect.remModeExtension(ext,magic);
+          else
+            pe = collect.addModeExtension(ext,magic);
+
+          if ( pe.has_err() )
+            return pe.with_file(possModeFile, dp.line_num);
+        }
+
+        if (extCount > 0 ) continue;
+
+        char charCount[64];
+        sprintf(&charCount[0],"%lu",(unsigned long)strlen((char *)dp.value));
+        return  make_err(empty_file_ext,charCount).with_file(possModeFile,dp.line_num);
+      }
+
+      return make_err(expect_mode_key,"ext[tension]/magic/desc[ription]/rel[ation]")
+        .with_file(possModeFile,dp.line_num);
+    
+    }//while getdata_pair
+    
+    return collect.build(toParse,dp.line_num,possModeFile.str());
+  }
+
+  static PosibErr<void> read_static_mode(const StaticMode & mode,
+                                         FilterMode & collect)
+  {
+    StringIStream toParse(mode.data, '\n');
+    String fname = "<built-in>/";
+    fname += mode.name;
+    fname += ".amf";
+    return read_mode(toParse, mode.name, fname, collect);
+  }
+
+  // Reads a single mode without listing all the mode files in the
+  // filter path, returns false if there is no such mode.
+  static PosibErr<bool> find_mode(const Config * config, ParmStr name,
+                                  FilterMode & collect)
+  {
+    if (strchr(name, '/')) return false;
+    String file = name;
+    file += ".amf";
+    if (find_file(config, "filter-path", file) != 0) {
+      FStream toParse;
+      RET_ON_ERR(toParse.open(file.str(),"rb"));
+      RET_ON_ERR(read_mode(toParse, name, file, collect));
+      return true;
+    }
+    for (unsigned i = 0; i != static_modes_size; ++i) {
+      if (name == static_modes[i].name) {
+        RET_ON_ERR(read_static_mode(static_modes[i], collect));
+        return true;
+      }
+    }
+    return false;
+  }
+
   static GlobalCache<FilterModeList> filter_modes_cache("filter_modes");
 
   PosibErr<void> set_mode_from_extension (Config * config, ParmString filename, FILE * in) 
@@ -487,13 +616,9 @@ namespace acommon {
     RET_ON_ERR_SET(static_cast<ModeNotifierImpl *>(config->filter_mode_notifier)
                    ->get_filter_modes(), FilterModeList *, fm);
 
-    for ( FilterModeList::iterator it = fm->begin(); it != fm->end(); it++ ) 
-    {
-      if ( it->lockFileToMode(filename,in) ) {
-        RET_ON_ERR(config->replace("mode", it->modeName().str()));
-        break;
-      }
-    }
+    const FilterMode * mode = fm->find_by_extension(filename);
+    if ( mode )
+      RET_ON_ERR(config->replace("mode", mode->modeName().str()));
     return no_err;
   }
 
@@ -520,6 +645,12 @@ namespace acommon {
   PosibErr<void> ModeNotifierImpl::item_updated(const KeyInfo * ki, ParmStr value)
   {
     if ( strcmp(ki->name, "mode") == 0 ) {
+      if (!filter_modes_) {
+        FilterMode mode(value);
+        RET_ON_ERR_SET(find_mode(config, value, mode), bool, found);
+        if (found)
+          return mode.expand(config);
+      }
       RET_ON_ERR_SET(get_filter_modes(), FilterModeList *, filter_modes);
       for ( Vector<FilterMode>::iterator it = filter_modes->begin() ;
             it != filter_modes->end() ; it++ ) {
@@ -585,163 +716,62 @@ namespace acommon {
 
       RET_ON_ERR(toParse.open(possModeFile.str(),"rb"));
 
-      String buf;
-      DataPair dp;
-
-      bool get_sucess = getdata_pair(toParse, dp, buf);
-      
-      to_lower(dp.key);
-      to_lower(dp.value);
-      if (    !get_sucess
-           || ( dp.key != "mode" ) 
-           || ( dp.value != possMode.str() ) )
-        return make_err(expect_mode_key,"mode").with_file(possModeFile, dp.line_num);
-
-      get_sucess = getdata_pair(toParse, dp, buf);
-      to_lower(dp.key);
-      if (    !get_sucess
-           || ( dp.key != "aspell" )
-           || ( dp.value == NULL )
-           || ( *(dp.value) == '\0' ) )
-        return make_err(mode_version_requirement).with_file(possModeFile, dp.line_num);
-
-#ifdef FILTER_VERSION_CONTROL
-      PosibErr<void> peb = check_version(dp.value.str);
-      if (peb.has_err()) return peb.with_file(possModeFile, dp.line_num);
-#endif
-      
       FilterMode collect(possMode);
-      
-      while ( getdata_pair(toParse,dp,buf) ) {
-        to_lower(dp.key);
-        if (   ( dp.key == "desc" ) 
-            || ( dp.key == "description" ) ) 
-        {
-          unescape(dp.value);
-          collect.setDescription(dp.value);
-          break;
-        }
-        if ( dp.key == "magic" ) {
-
-          char * regbegin = dp.value;
-
-          while (    regbegin
-                  && ( *regbegin != '/' ) ) {
-            regbegin++;
-          }
-          if (    ( regbegin == NULL )
-               || ( *regbegin == '\0' ) 
-               || ( *(++regbegin) == '\0' ) )
-            return make_err(missing_magic_expression).with_file(possModeFile, dp.line_num);
-          
-          char * regend = regbegin;
-          bool prevslash = false;
-
-          while (    regend
-                  && ( *regend != '\0' )
-                  && (    prevslash
-                       || ( * regend != '/' ) ) )  {
-            if ( *regend == '\\' ) {
-              prevslash = !prevslash;
-            }
-            else {
-              prevslash = false;
-            }
-            regend ++ ;
-          }
-          if ( regend == regbegin )
-            return make_err(missing_magic_expression).with_file(possModeFile, dp.line_num);
-
-          char swap = *regend;
-
-          *regend = '\0';
-          
-          String magic(regbegin);
-          
-          *regend = swap;
-
-          unsigned int extCount = 0;
-
-          while ( *regend != '\0' ) {
-            regend ++;
-            extCount ++;
-            regbegin = regend;
-            while (    ( *regend != '/' ) 
-                    && ( *regend != '\0' ) ) {
-              regend++;
-            }
-            if ( regend == regbegin ) 
-            {
-              char charCount[64];
-              sprintf(&charCount[0],"%li",(long)(regbegin - (char *)dp.value));
-              return  make_err(empty_file_ext,charCount).with_file(possModeFile,dp.line_num);
-            }
-
-            bool remove = false;
-            bool add = true;
-
-            if ( *regbegin == '+' ) {
-              regbegin++;
-            }
-            else if ( *regbegin == '-' ) {
-              add = false;
-              remove = true;
-              regbegin++;
-            }
-            if ( regend == regbegin ) 
-            {
-              char charCount[64];
-              sprintf(&charCount[0],"%li",(long)(regbegin - (char *)dp.value));
-              return  make_err(empty_file_ext,charCount).with_file(possModeFile,dp.line_num);
-            }
-            swap = *regend;
-            *regend = '\0';
-            
-            String ext(regbegin);
-
-            *regend = swap;
-
-            // partially unescape magic
-            
-            char * dest = magic.mstr();
-            const char * src  = magic.mstr();
-            while (*src) {
-              if ((*src == '\\' && src[1] == '/') || src[1] == '#')
-                ++src;
-              *dest++ = *src++;
-            }
-            magic.resize(dest - magic.mstr());
-
-            PosibErr<bool> pe;
-
-            if ( remove )
-              pe = collect.remModeExtension(ext,magic);
-            else
-              pe = collect.addModeExtension(ext,magic);
-
-            if ( pe.has_err() )
-              return pe.with_file(possModeFile, dp.line_num);
-          }
+      RET_ON_ERR(read_mode(toParse, possMode, possModeFile, collect));
 
-          if (extCount > 0 ) continue;
-
-          char charCount[64];
-          sprintf(&charCount[0],"%lu",(unsigned long)strlen((char *)dp.value));
-          return  make_err(empty_file_ext,charCount).with_file(possModeFile,dp.line_num);
-        }
-
-        return make_err(expect_mode_key,"ext[tension]/magic/desc[ription]/rel[ation]")
-          .with_file(possModeFile,dp.line_num);
-      
-      }//while getdata_pair
-      
-      RET_ON_ERR(collect.build(toParse,dp.line_num,possModeFile.str()));
+      filter_modes->push_back(collect);
+    }
 
+    for (unsigned i = 0; i != static_modes_size; ++i) {
+      Vector<FilterMode>::iterator fmIt = filter_modes->begin();
+      for ( ; fmIt != filter_modes->end() ; fmIt++ ) {
+        if ( (*fmIt).modeName() == static_modes[i].name )
+          break;
+      }
+      if ( fmIt != filter_modes->end() )
+        continue;
+      FilterMode collect(static_modes[i].name);
+      RET_ON_ERR(read_static_mode(static_modes[i], collect));
       filter_modes->push_back(collect);
     }
+    filter_modes->index_extensions();
     return filter_modes.release();
   }
 
+  // The magic of a mode is only checked for being valid when the
+  // mode is read, a file is locked to the first mode which lists
+  // one of its extensions, so the file itself never needs to be
+  // opened.
+
+  void FilterModeList::index_extensions()
+  {
+    ext_index.clear();
+    for ( unsigned i = 0; i != size(); ++i ) {
+      const Vector<FilterMode::MagicString> & keys = (*this)[i].magic();
+      for ( Vector<FilterMode::MagicString>::const_iterator it = keys.begin();
+            it != keys.end() ; it++ ) {
+        for ( Vector<String>::const_iterator extIt = it->extensions().begin();
+              extIt != it->extensions().end() ; extIt++ )
+          ext_index.insert(hash_map<String, unsigned>::value_type(*extIt, i));
+      }
+    }
+  }
+
+  const FilterMode * FilterModeList::find_by_extension(ParmStr fileName) const
+  {
+    unsigned found = size();
+    const char * end = fileName.str() + fileName.size();
+    for ( const char * p = end; p != fileName.str(); ) {
+      --p;
+      if ( *p != '.' ) continue;
+      hash_map<String, unsigned>::const_iterator it
+        = ext_index.find(String(p + 1, end - p - 1));
+      if ( it != ext_index.end() && it->second < found )
+        found = it->second;
+    }
+    return found < size() ? &(*this)[found] : 0;
+  }
+
   void activate_filter_modes(Config *config) 
   {
     config->add_notifier(new ModeNotifierImpl(config));
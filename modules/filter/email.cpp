@@ -64,6 +64,7 @@ namespace {
   {
     name_ = "email-filter";
     order_num_ = 0.85;
+    streaming_ = true;
     is_quote_char.conv.setup(*opts, "utf-8", "ucs-4", NormNone);
     opts->retrieve_list("f-email-quote", &is_quote_char);
     margin = opts->retrieve_int("f-email-margin");
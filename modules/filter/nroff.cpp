@@ -86,6 +86,7 @@ namespace {
   {
     name_ = "nroff-filter";
     order_num_ = 0.2;
+    streaming_ = true;
     reset();
     return true;
   }
@@ -27,6 +27,7 @@
 #include "config.hpp"
 #include "indiv_filter.hpp"
 #include "string_map.hpp"
+#include "mem_report.hpp"
 #include "mutable_container.hpp"
 #include "clone_ptr-t.hpp"
 #include "filter_char_vector.hpp"
@@ -129,12 +130,17 @@ namespace {
     PosibErr<bool> setup(Config *);
     void reset();
     void process(FilterChar * &, FilterChar * &);
+    void memory_usage(MemReport & r) const {
+      r.add(name(), sizeof(*this) 
+            + check_attribs.calc_size() + skip_tags.calc_size());
+    }
   };
 
   PosibErr<bool> SgmlFilter::setup(Config * opts) 
   {
     name_ = which + "-filter";
     order_num_ = 0.35;
+    streaming_ = true;
     check_attribs.clear();
     skip_tags.clear();
     opts->retrieve_list("f-" + which + "-skip",  &skip_tags);
@@ -399,6 +405,22 @@ namespace {
   {
     FilterChar * cur = str;
     while (cur != stop) {
+      // Fast path for plain text and comments: a run of characters
+      // which can't change the state is skipped, or blanked out if
+      // it is not to be checked, without going through process_char.
+      if (in_what == S_text || in_what == S_com) {
+        FilterChar * run = cur;
+        if (in_what == S_text)
+          while (cur != stop && *cur != '<' && *cur != '&') ++cur;
+        else
+          while (cur != stop && *cur != '-') ++cur;
+        if (cur != run) {
+          lookbehind = cur[-1];
+          if (skipall || in_what == S_com)
+            for (FilterChar * i = run; i != cur; ++i) *i = ' ';
+          if (cur == stop) break;
+        }
+      }
       if (process_char(*cur))
 	*cur = ' ';
       ++cur;
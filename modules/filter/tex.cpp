@@ -35,7 +35,6 @@ namespace {
     enum InWhat {Name, Opt, Parm, Other, Swallow};
     struct Command {
       InWhat in_what;
-      String name;
       const char * do_check;
       Command() {}
       Command(InWhat w) : in_what(w), do_check("P") {}
@@ -44,6 +43,9 @@ namespace {
     bool in_comment;
     bool prev_backslash;
     Vector<Command> stack;
+    // the name of the command being read, only the command on the top
+    // of the stack can be in the Name state so one buffer is enough
+    String name;
 
     class Commands : public StringMap {
     public:
@@ -89,6 +91,7 @@ namespace {
   {
     name_ = "tex-filter";
     order_num_ = 0.35;
+    streaming_ = true;
     //fprintf(stderr,"name %s \n",name_);
 
     commands.clear();
@@ -124,27 +127,26 @@ namespace {
     if (top.in_what == Name) {
       if (asc_isalpha(c)) {
 
-	top.name += c;
+	name += c;
 	return true;
 
       } else {
 
-	if (top.name.empty() && (c == '@')) {
-	  top.name += c;
+	if (name.empty() && (c == '@')) {
+	  name += c;
 	  return true;
 	}
 	  
 	top.in_what = Other;
 
-	if (top.name.empty()) {
-	  top.name.clear();
-	  top.name += c;
-	  top.do_check = commands.lookup(top.name.c_str());
+	if (name.empty()) {
+	  name += c;
+	  top.do_check = commands.lookup(name.c_str());
 	  if (top.do_check == 0) top.do_check = "";
 	  return !asc_isspace(c);
 	}
 
-	top.do_check = commands.lookup(top.name.c_str());
+	top.do_check = commands.lookup(name.c_str());
 	if (top.do_check == 0) top.do_check = "";
 
 	if (asc_isspace(c)) { // swallow extra spaces
@@ -203,6 +205,7 @@ namespace {
     if (c == '\\') {
       prev_backslash = true;
       push_command(Name);
+      name.clear();
       return true;
     }
 
@@ -230,6 +233,25 @@ namespace {
     FilterChar * cur = str;
 
     while (cur != stop) {
+      // Fast path for the rest of a comment line and for plain text
+      // inside a parameter, where every character up to the next one
+      // that may change the state is handled the same.
+      FilterChar * run = cur;
+      bool blank = false;
+      if (in_comment) {
+        while (cur != stop && *cur != '\n') ++cur;
+        blank = !check_comments;
+      } else if (top.in_what == Parm && *top.do_check != '\0') {
+        while (cur != stop && *cur != '%' && *cur != '\\' 
+               && *cur != '{' && *cur != '}') ++cur;
+        blank = *top.do_check == 'p';
+      }
+      if (cur != run) {
+        prev_backslash = false;
+        if (blank)
+          for (FilterChar * i = run; i != cur; ++i) *i = ' ';
+        if (cur == stop) break;
+      }
       if (process_char(*cur))
 	*cur = ' ';
       ++cur;
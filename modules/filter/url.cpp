@@ -22,6 +22,7 @@ namespace {
   {
     name_ = "url-filter";
     order_num_ = 0.95;
+    streaming_ = true;
     return true;
   }
 
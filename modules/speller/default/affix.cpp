@@ -56,6 +56,8 @@
 #include "vararray.hpp"
 #include "lsort.hpp"
 #include "hash-t.hpp"
+#include "stats.hpp"
+#include "mem_report.hpp"
 
 #include "gettext.h"
 
@@ -263,6 +265,11 @@ AffixMgr::AffixMgr(const Language * l)
 
 AffixMgr::~AffixMgr() {}
 
+void AffixMgr::memory_usage(MemReport & r) const
+{
+  r.add("affix entries", sizeof(*this) + data_buf.calc_size());
+}
+
 static inline void max_(int & lhs, int rhs) 
 {
   if (lhs < rhs) lhs = rhs;
@@ -760,27 +767,37 @@ bool AffixMgr::prefix_check (const LookupInfo & linf, ParmString word,
                              CheckInfo & ci, GuessInfo * gi, bool cross) const
 {
  
+  unsigned tried = 0;
+
   // first handle the special case of 0 length prefixes
   PfxEntry * pe = pStart[0];
   while (pe) {
-    if (pe->check(linf,this,word,ci,gi)) return true;
+    ++tried;
+    if (pe->check(linf,this,word,ci,gi)) goto found;
     pe = pe->next;
   }
   
   // now handle the general case
-  byte sp = *reinterpret_cast<const byte *>(word.str());
-  PfxEntry * pptr = pStart[sp];
-
-  while (pptr) {
-    if (isSubset(pptr->key(),word)) {
-      if (pptr->check(linf,this,word,ci,gi,cross)) return true;
-      pptr = pptr->next_eq;
-    } else {
-      pptr = pptr->next_ne;
+  {
+    byte sp = *reinterpret_cast<const byte *>(word.str());
+    PfxEntry * pptr = pStart[sp];
+
+    while (pptr) {
+      if (isSubset(pptr->key(),word)) {
+        ++tried;
+        if (pptr->check(linf,this,word,ci,gi,cross)) goto found;
+        pptr = pptr->next_eq;
+      } else {
+        pptr = pptr->next_ne;
+      }
     }
   }
     
+  stat_add(STAT_PREFIX_TRIED, tried);
   return false;
+found:
+  stat_add(STAT_PREFIX_TRIED, tried);
+  return true;
 }
 
 
@@ -790,27 +807,37 @@ bool AffixMgr::suffix_check (const LookupInfo & linf, ParmString word,
                              int sfxopts, AffEntry * ppfx) const
 {
 
+  unsigned tried = 0;
+
   // first handle the special case of 0 length suffixes
   SfxEntry * se = sStart[0];
   while (se) {
-    if (se->check(linf, word, ci, gi, sfxopts, ppfx)) return true;
+    ++tried;
+    if (se->check(linf, word, ci, gi, sfxopts, ppfx)) goto found;
     se = se->next;
   }
   
   // now handle the general case
-  byte sp = *((const byte *)(word + word.size() - 1));
-  SfxEntry * sptr = sStart[sp];
-
-  while (sptr) {
-    if (isRevSubset(sptr->key(), word + word.size() - 1, word.size())) {
-      if (sptr->check(linf, word, ci, gi, sfxopts, ppfx)) return true;
-      sptr = sptr->next_eq;
-    } else {
-      sptr = sptr->next_ne;
+  {
+    byte sp = *((const byte *)(word + word.size() - 1));
+    SfxEntry * sptr = sStart[sp];
+
+    while (sptr) {
+      if (isRevSubset(sptr->key(), word + word.size() - 1, word.size())) {
+        ++tried;
+        if (sptr->check(linf, word, ci, gi, sfxopts, ppfx)) goto found;
+        sptr = sptr->next_eq;
+      } else {
+        sptr = sptr->next_ne;
+      }
     }
   }
     
+  stat_add(STAT_SUFFIX_TRIED, tried);
   return false;
+found:
+  stat_add(STAT_SUFFIX_TRIED, tried);
+  return true;
 }
 
 // check if word with affixes is correctly spelled
@@ -981,6 +1008,7 @@ int LookupInfo::lookup (ParmString word, const SensitiveCompare * c,
 {
   SpellerImpl::WS::const_iterator i = begin;
   const char * g = 0;
+  stat_add(STAT_STEM_LOOKUP);
   if (mode == Word) {
     do {
       (*i)->lookup(word, c, o);
@@ -1100,6 +1128,7 @@ bool PfxEntry::check(const LookupInfo & linf, const AffixMgr * pmyMgr,
       CheckInfo * lci = 0;
       CheckInfo * guess = 0;
       tmpl += stripl;
+      stat_add(STAT_PREFIX_MATCHED);
 
       int res = linf.lookup(tmpword, &linf.sp->s_cmp_end, achar, wordinfo, gi);
 
@@ -1258,6 +1287,7 @@ bool SfxEntry::check(const LookupInfo & linf, ParmString word,
     if (cond < 0) {
       CheckInfo * lci = 0;
       tmpl += stripl;
+      stat_add(STAT_SUFFIX_MATCHED);
       const SensitiveCompare * cmp = 
         optflags & XPRODUCT ? &linf.sp->s_cmp_middle : &linf.sp->s_cmp_begin;
       int res = linf.lookup(tmpword, cmp, achar, wordinfo, gi);
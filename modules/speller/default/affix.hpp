@@ -32,6 +32,7 @@ namespace acommon {
   class Config;
   struct CheckInfo;
   struct Conv;
+  class MemReport;
 }
 
 namespace aspeller {
@@ -85,6 +86,8 @@ namespace aspeller {
 
     unsigned int max_strip() const {return max_strip_;}
 
+    void memory_usage(MemReport &) const;
+
     PosibErr<void> setup(ParmString affpath, Conv &);
 
     bool affix_check(const LookupInfo &, ParmString, CheckInfo &, GuessInfo *) const;
@@ -0,0 +1,91 @@
+// This file is part of The New Aspell
+// Copyright (C) 2004 by Kevin Atkinson under the GNU LGPL
+// license version 2.0 or 2.1.  You should have received a copy of the
+// LGPL license along with this library if you did not you can find it
+// at http://www.gnu.org/.
+
+#ifndef __aspeller_check_cache__
+#define __aspeller_check_cache__
+
+#include <string.h>
+
+#include "check_list.hpp"
+
+namespace aspeller {
+
+  // A small direct mapped cache of the results of check.  Since
+  // natural text uses the same words over and over again remembering
+  // the result for recently seen words avoids repeating the
+  // dictionary lookups and affix analysis.  The keys and the check
+  // info are stored in separate arrays so that a lookup only touches
+  // a single 32 byte key.  The cache MUST be cleared whenever
+  // anything changes which may affect the result of check.  Its hits
+  // and misses are counted by SpellerImpl::check as statistics.
+
+  class CheckCache {
+  public:
+    static const unsigned int size = 1024; // must be a power of 2
+    static const unsigned int max_word_size = 29;
+
+    struct Key {
+      unsigned char word_size; // 0 if the slot is empty
+      bool correct;
+      char word[max_word_size + 1];
+    };
+
+    CheckCache() {clear();}
+
+    void clear() {
+      for (unsigned int i = 0; i != size; ++i)
+        keys_[i].word_size = 0;
+    }
+
+    // returns the slot index for the word or -1 if the word is not in
+    // the cache
+    int lookup(const char * word, unsigned int word_size) {
+      if (word_size == 0 || word_size > max_word_size) return -1;
+      unsigned int i = hash(word, word_size);
+      const Key & k = keys_[i];
+      if (k.word_size == word_size && memcmp(k.word, word, word_size) == 0)
+        return i;
+      else
+        return -1;
+    }
+
+    bool correct(int i) const {return keys_[i].correct;}
+    const CheckInfo & check_info(int i) const {return infos_[i];}
+
+    // ci is only used when the word is correct, if ci.word points
+    // inside the word it will point inside the cached copy instead
+    void insert(const char * word, unsigned int word_size,
+                bool correct, const CheckInfo & ci) {
+      if (word_size == 0 || word_size > max_word_size) return;
+      unsigned int i = hash(word, word_size);
+      Key & k = keys_[i];
+      k.word_size = word_size;
+      k.correct = correct;
+      memcpy(k.word, word, word_size);
+      k.word[word_size] = '\0';
+      CheckInfo & inf = infos_[i];
+      inf = ci;
+      inf.next = 0;
+      const char * w = ci.word.str();
+      if (w >= word && w < word + word_size)
+        inf.word = ParmString(k.word + (w - word), ci.word.size());
+    }
+
+  private:
+    static unsigned int hash(const char * w, unsigned int s) {
+      unsigned int h = 0;
+      for (const char * end = w + s; w != end; ++w)
+        h = 5*h + static_cast<unsigned char>(*w);
+      return (h ^ (h >> 10)) & (size - 1);
+    }
+
+    Key keys_[size];
+    CheckInfo infos_[size];
+  };
+
+}
+
+#endif
@@ -418,8 +418,12 @@ namespace aspeller {
     Lock dict_cache_lock(NULL);
 
     if (actual_type == DT_ReadOnly) { // try to get it from the cache
-      dict_cache_lock.set(&dict_cache.lock); 
       res = dict_cache.find(id);
+      if (!res) {
+        // check again with the lock held so that it is only loaded once
+        dict_cache_lock.set(&dict_cache.lock); 
+        res = dict_cache.find(id);
+      }
     }
 
     if (!res) {
@@ -442,19 +446,18 @@ namespace aspeller {
         abort();
       }
 
-      RET_ON_ERR(w->load(true_file_name, config, new_dicts, speller));
+      clock_t start = clock();
+      PosibErr<void> err = w->load(true_file_name, config, new_dicts, speller);
+      if (actual_type == DT_ReadOnly)
+        dict_cache.loaded(start);
+      RET_ON_ERR(err);
 
       if (actual_type == DT_ReadOnly)
         dict_cache.add(w);
       
       res = w.release();
 
-    } else { // actual_type == DT_ReadOnly implied, and hence the lock
-             // is already acquired
-
-      res->copy_no_lock();
-      
-    }
+    } // else find already took a reference
 
     dict_cache_lock.release();
 
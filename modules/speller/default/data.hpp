@@ -23,6 +23,7 @@ namespace acommon {
   class FStream;
   class OStream;
   class Convert;
+  class WordListReader;
 }
 
 namespace aspeller {
@@ -71,6 +72,7 @@ namespace aspeller {
   public:
     typedef Id CacheKey;
     bool cache_key_eq(const Id &);
+    const char * cache_key_str() const {return file_name();}
 
     enum BasicType {no_type, basic_dict, replacement_dict, multi_dict};
     const BasicType basic_type;
@@ -206,8 +208,20 @@ namespace aspeller {
   // implemented in readonly_ws.cc
   Dictionary * new_default_readonly_dict();
   
+  // the dict name is stored in the header and may be any string
+  // which does not contain a null
   PosibErr<void> create_default_readonly_dict(StringEnumeration * els,
-                                              Config & config);
+                                              Config & config,
+                                              ParmString dict_name = 0);
+  // reads the word lists directly, they may be compressed with prezip
+  // or word-list-compress
+  PosibErr<void> create_default_readonly_dict(WordListReader * in,
+                                              Config & config,
+                                              ParmString dict_name = 0);
+
+  // returns the dict name of a dictionary returned by
+  // new_default_readonly_dict, or a single space if none was given
+  const char * readonly_dict_name(const Dictionary *);
   
   // implemented in multi_ws.cc
   MultiDict * new_default_multi_dict();
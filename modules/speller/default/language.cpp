@@ -19,6 +19,8 @@
 #include "cache-t.hpp"
 #include "getdata.hpp"
 #include "file_util.hpp"
+#include "mem_report.hpp"
+#include "word_list_reader.hpp"
 
 #ifdef ENABLE_NLS
 #  include <langinfo.h>
@@ -78,6 +80,17 @@ namespace aspeller {
 
   static GlobalCache<Language> language_cache("language");
 
+  void Language::memory_usage(MemReport & r) const
+  {
+    r.begin(name_);
+    r.add("tables", sizeof(*this));
+    r.add("repl table", 
+          buf_.calc_size() + repls_.capacity() * sizeof(SuggestRepl));
+    if (affix_) affix_->memory_usage(r);
+    if (soundslike_) soundslike_->memory_usage(r);
+    r.end();
+  }
+
   PosibErr<void> Language::setup(const String & lang, const Config * config)
   {
     //
@@ -636,7 +649,16 @@ namespace aspeller {
   WordListIterator::WordListIterator(StringEnumeration * in0,
                                    const Language * lang0,
                                    OStream * log0)
-    : in(in0), lang(lang0), log(log0), val(), str(0), str_end(0),
+    : in(in0), reader(0), lang(lang0), log(log0), val(), str(0), str_end(0),
+      clean_affix(lang0, log0)
+  {
+    memset(brk, '\0', sizeof(brk));
+  }
+
+  WordListIterator::WordListIterator(WordListReader * in0,
+                                     const Language * lang0,
+                                     OStream * log0)
+    : in(0), reader(in0), lang(lang0), log(log0), val(), str(0), str_end(0),
       clean_affix(lang0, log0)
   {
     memset(brk, '\0', sizeof(brk));
@@ -666,7 +688,12 @@ namespace aspeller {
   {
   loop:
     if (!str) {
-      orig = in->next();
+      if (reader) {
+        RET_ON_ERR_SET(reader->next(), const char *, line);
+        orig = line;
+      } else {
+        orig = in->next();
+      }
       if (!orig) return false;
       if (!*orig) goto loop;
       PosibErr<const char *> pe = iconv(orig);
@@ -20,6 +20,7 @@ using namespace acommon;
 
 namespace acommon {
   struct CheckInfo;
+  class WordListReader;
 }
 
 namespace aspeller {
@@ -347,6 +348,8 @@ namespace aspeller {
     }
 
     bool cache_key_eq(const String & l) const  {return name_ == l;}
+    const char * cache_key_str() const {return name_.str();}
+    void memory_usage(MemReport &) const;
   };
 
   typedef Language LangImpl;
@@ -436,6 +439,10 @@ namespace aspeller {
     WordListIterator(StringEnumeration * in,
                      const Language * lang,
                      OStream * log);
+    // reads the word lists directly, which may be compressed
+    WordListIterator(WordListReader * in,
+                     const Language * lang,
+                     OStream * log);
     // init may set "norm-strict" to true which is why it is not const
     PosibErr<void> init (Config & config);
     const Value * operator-> () const {return &val;}
@@ -448,6 +455,7 @@ namespace aspeller {
     bool skip_invalid_words;
     bool clean_affixes;
     StringEnumeration * in;
+    WordListReader * reader;
     const Language * lang;
     ConvEC iconv;
     OStream * log;
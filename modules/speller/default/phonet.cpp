@@ -37,6 +37,7 @@
 #include "getdata.hpp"
 #include "language.hpp"
 #include "objstack.hpp"
+#include "mem_report.hpp"
 #include "vararray.hpp"
 
 using namespace acommon;
@@ -67,8 +68,12 @@ namespace aspeller {
 
   struct PhonetParmsImpl : public PhonetParms {
     void * data;
+    size_t data_size;
     ObjStack strings;
-    PhonetParmsImpl() : data(0) {}
+    PhonetParmsImpl() : data(0), data_size(0) {}
+    void memory_usage(MemReport & r) const {
+      r.add("phonet rules", sizeof(*this) + data_size + strings.calc_size());
+    }
     ~PhonetParmsImpl() {if (data) free(data);}
   };
 
@@ -110,6 +115,7 @@ namespace aspeller {
 
     size_t vsize = sizeof(char *) * (2 * num + 2);
     parms->data = malloc(vsize);
+    parms->data_size = vsize;
 
     const char * * r = (const char * *)parms->data;
 
@@ -25,7 +25,7 @@
 
 using namespace acommon;
 
-namespace acommon {struct Conv;}
+namespace acommon {struct Conv; class MemReport;}
 
 namespace aspeller {
 
@@ -49,6 +49,7 @@ namespace aspeller {
     static const int hash_size = 256;
     int hash[hash_size];
 
+    virtual void memory_usage(MemReport &) const = 0;
     virtual ~PhonetParms() {}
   };
 
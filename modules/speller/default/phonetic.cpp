@@ -129,6 +129,10 @@ namespace aspeller {
 
     PhonetSoundslike(const Language * l) : lang(l) {}
 
+    void memory_usage(MemReport & r) const {
+      phonet_parms->memory_usage(r);
+    }
+
     PosibErr<void> setup(Conv & iconv) {
       String file;
       file += lang->data_dir();
@@ -7,7 +7,7 @@
 
 using namespace acommon;
 
-namespace acommon {struct Conv;}
+namespace acommon {struct Conv; class MemReport;}
 
 namespace aspeller {
 
@@ -21,6 +21,8 @@ namespace aspeller {
     virtual const char * name() const = 0;
     virtual const char * version() const = 0;
     virtual PosibErr<void> setup(Conv &) = 0;
+    // adds the memory used to the report, nothing by default
+    virtual void memory_usage(MemReport &) const {}
     virtual ~Soundslike() {}
   };
 
@@ -45,7 +45,9 @@ using std::pair;
 #include "file_util.hpp"
 #include "fstream.hpp"
 #include "language.hpp"
+#include "mem_report.hpp"
 #include "stack_ptr.hpp"
+#include "stats.hpp"
 #include "objstack.hpp"
 #include "vector.hpp"
 #include "vector_hash-t.hpp"
@@ -199,6 +201,7 @@ namespace {
 
   public: //but don't use
 
+    // counts the entries compared when the stats are enabled
     struct WordLookupParms {
       const char * block_begin;
       WordLookupParms() {}
@@ -225,6 +228,7 @@ namespace {
     WordLookup       word_lookup;
     const char *     word_block;
     const char *     first_word;
+    String           dict_name;
     
     ReadOnlyDict(const ReadOnlyDict&);
     ReadOnlyDict& operator= (const ReadOnlyDict&);
@@ -252,6 +256,9 @@ namespace {
       }
     }
     
+    size_t cache_size() const {return sizeof(*this) + block_size;}
+    void memory_usage(MemReport &) const;
+
     PosibErr<void> load(ParmString, Config &, DictList *, SpellerImpl *);
     PosibErr<void> check_hash_fun() const;
     void low_level_dump() const;
@@ -443,6 +450,8 @@ namespace {
 
     word.resize(data_head.dict_name_size);
     f.read(word.data(), data_head.dict_name_size);
+    word.push_back('\0');
+    dict_name = word.data();
 
     word.resize(data_head.lang_name_size);
     f.read(word.data(), data_head.lang_name_size);
@@ -512,6 +521,24 @@ namespace {
     return no_err;
   }
 
+  void ReadOnlyDict::memory_usage(MemReport & r) const
+  {
+    r.begin(file_name());
+    r.add("object", sizeof(*this));
+    const char * hash_begin 
+      = reinterpret_cast<const char *>(word_lookup.vector().begin());
+    const char * parts[4] = {block, word_block, hash_begin, block + block_size};
+    static const char * const names[3] 
+      = {"jump tables", "word block", "hash table"};
+    for (int i = 0; i != 3; ++i) {
+      if (mmaped_block)
+        r.add_mapped(names[i], parts[i], parts[i+1] - parts[i]);
+      else
+        r.add(names[i], parts[i+1] - parts[i]);
+    }
+    r.end();
+  }
+
   void lookup_adv(WordEntry * wi);
 
   static inline void prep_next(WordEntry * wi, 
@@ -543,18 +570,24 @@ namespace {
                             WordEntry & o) const 
   {
     o.clear();
-    WordLookup::const_iterator i = word_lookup.find(word);
-    if (i == word_lookup.end()) return false;
-    const char * w = word_block + *i;
+    stat_add(STAT_DICT_LOOKUP);
+    WordLookup::ConstFindIterator i = word_lookup.multi_find(word);
+    stat_add(STAT_DICT_PROBE, i.probes);
+    if (i.at_end()) return false;
+    const char * w = word_block + i.deref();
+    unsigned dups = 0;
     for (;;) {
       if ((*c)(word, w)) {
         convert(w,o);
         prep_next(&o, w, c, word);
+        stat_add(STAT_DICT_DUPLICATE, dups);
         return true;
       }
       if (!duplicate_flag(w)) break;
       w = get_next(w);
+      ++dups;
     }
+    stat_add(STAT_DICT_DUPLICATE, dups);
     return false;
   }
 
@@ -704,9 +737,11 @@ namespace {
   bool ReadOnlyDict::clean_lookup(ParmString sl, WordEntry & o) const
   {
     o.clear();
-    WordLookup::const_iterator i = word_lookup.find(sl);
-    if (i == word_lookup.end()) return false;
-    const char * w = word_block + *i;
+    stat_add(STAT_DICT_LOOKUP);
+    WordLookup::ConstFindIterator i = word_lookup.multi_find(sl);
+    stat_add(STAT_DICT_PROBE, i.probes);
+    if (i.at_end()) return false;
+    const char * w = word_block + i.deref();
     convert(w, o);
     if (duplicate_flag(w)) o.adv_ = clean_lookup_adv;
     return true;
@@ -828,9 +863,10 @@ namespace {
       out << '\0';
   }
 
-  PosibErr<void> create (StringEnumeration * els,
+  PosibErr<void> create (WordListIterator & wl_itr,
 			 const Language & lang,
-                         Config & config) 
+                         Config & config,
+                         ParmString dict_name) 
   {
     assert(sizeof(u16int) == 2);
     assert(sizeof(u32int) == 4);
@@ -870,7 +906,7 @@ namespace {
 
     data_head.endian_check = 12345678;
 
-    data_head.dict_name_size = 1;
+    data_head.dict_name_size = dict_name.empty() ? 1 : dict_name.size() + 1;
     data_head.lang_name_size = strlen(lang.name()) + 1;
     data_head.soundslike_name_size    = strlen(lang.soundslike_name()) + 1;
     data_head.soundslike_version_size = strlen(lang.soundslike_version()) + 1;
@@ -909,7 +945,6 @@ namespace {
     // Read in Wordlist
     //
     {
-      WordListIterator wl_itr(els, &lang, config.retrieve_bool("warn") ? &CERR : 0);
       wl_itr.init(config);
       ObjStack exp_buf;
       WordAff * exp_list;
@@ -1004,7 +1039,6 @@ namespace {
 
         }
       }
-      delete els;
     }
 
     //
@@ -1246,7 +1280,10 @@ namespace {
     // write data head to file
     out.seek(0);
     out.write(&data_head, sizeof(DataHead));
-    out.write(" ", 1);
+    if (dict_name.empty())
+      out.write(" ", 1);
+    else
+      out.write(dict_name.str(), dict_name.size() + 1);
     out.write(lang.name(), data_head.lang_name_size);
     out.write(lang.soundslike_name(), data_head.soundslike_name_size);
     out.write(lang.soundslike_version(), data_head.soundslike_version_size);
@@ -1257,16 +1294,38 @@ namespace {
 }
 
 namespace aspeller {
-  PosibErr<void> create_default_readonly_dict(StringEnumeration * els,
-                                              Config & config)
+  PosibErr<void> create_default_readonly_dict(StringEnumeration * els0,
+                                              Config & config,
+                                              ParmString dict_name)
   {
+    StackPtr<StringEnumeration> els(els0);
     CachePtr<Language> lang;
     PosibErr<Language *> res = new_language(config);
     if (res.has_err()) return res;
     lang.reset(res.data);
     lang->set_lang_defaults(config);
-    RET_ON_ERR(create(els,*lang,config));
+    WordListIterator wl_itr(els, lang, config.retrieve_bool("warn") ? &CERR : 0);
+    RET_ON_ERR(create(wl_itr,*lang,config,dict_name));
     return no_err;
   }
+
+  PosibErr<void> create_default_readonly_dict(WordListReader * in,
+                                              Config & config,
+                                              ParmString dict_name)
+  {
+    CachePtr<Language> lang;
+    PosibErr<Language *> res = new_language(config);
+    if (res.has_err()) return res;
+    lang.reset(res.data);
+    lang->set_lang_defaults(config);
+    WordListIterator wl_itr(in, lang, config.retrieve_bool("warn") ? &CERR : 0);
+    RET_ON_ERR(create(wl_itr,*lang,config,dict_name));
+    return no_err;
+  }
+
+  const char * readonly_dict_name(const Dictionary * d)
+  {
+    return static_cast<const ReadOnlyDict *>(d)->dict_name.str();
+  }
 }
 
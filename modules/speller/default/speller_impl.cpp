@@ -5,6 +5,7 @@
 // at http://www.gnu.org/.
 
 #include <stdlib.h>
+#include <string.h>
 #include <typeinfo>
 
 #include "clone_ptr-t.hpp"
@@ -19,6 +20,10 @@
 #include "tokenizer.hpp"
 #include "convert.hpp"
 #include "stack_ptr.hpp"
+#include "stats.hpp"
+#include "filter.hpp"
+#include "mem_report.hpp"
+#include "vararray.hpp"
 
 //#include "iostream.hpp"
 
@@ -51,16 +56,19 @@ namespace aspeller {
 
   PosibErr<void> SpellerImpl::add_to_personal(MutableString word) {
     if (!personal_) return no_err;
+    check_cache.clear();
     return personal_->add(word);
   }
   
   PosibErr<void> SpellerImpl::add_to_session(MutableString word) {
     if (!session_) return no_err;
+    check_cache.clear();
     return session_->add(word);
   }
 
   PosibErr<void> SpellerImpl::clear_session() {
     if (!session_) return no_err;
+    check_cache.clear();
     return session_->clear();
   }
 
@@ -170,6 +178,7 @@ namespace aspeller {
     bool res = check_affix(word, ci, gi);
     if (res) return true;
     if (!try_uppercase) return false;
+    stat_add(STAT_TITLE_RETRY);
     char t = *word;
     *word = lang_->to_title(t);
     res = check_affix(word, ci, gi);
@@ -191,10 +200,12 @@ namespace aspeller {
     if (res) return true;
     if (run_together_limit <= 1) return false;
     enum {Yes, No, Unknown} is_title = try_uppercase ? Yes : Unknown;
+    unsigned splits = 0;
     for (char * i = word + run_together_min_; 
          i <= word_end - run_together_min_;
          ++i) 
     {
+      ++splits;
       char t = *i;
       *i = '\0';
       //FIXME: clear ci, gi?
@@ -206,18 +217,171 @@ namespace aspeller {
       if (check(i, word_end, is_title == Yes, run_together_limit - 1, ci + 1, 0)) {
         ci->compound = true;
         ci->next = ci + 1;
+        stat_add(STAT_RUN_TOGETHER_SPLIT, splits);
         return true;
       }
     }
+    stat_add(STAT_RUN_TOGETHER_SPLIT, splits);
     return false;
   }
 
+  PosibErr<bool> SpellerImpl::check(MutableString word)
+  {
+    stat_add(STAT_CHECK);
+    guess_info.reset();
+    int c = check_cache.lookup(word.begin(), word.size);
+    if (c >= 0) {
+      stat_add(STAT_CHECK_CACHE_HIT);
+      trace("check", ParmString(word.begin(), word.size), 
+            check_cache.correct(c));
+      if (check_cache.correct(c)) {
+        check_inf[0] = check_cache.check_info(c);
+        return true;
+      } else {
+        clear_check_info(check_inf[0]);
+        return false;
+      }
+    }
+    stat_add(STAT_CHECK_CACHE_MISS);
+    RET_ON_ERR_SET(check(word.begin(), word.end(), false,
+                         unconditional_run_together_ ? run_together_limit_ : 0,
+                         check_inf, &guess_info), bool, res);
+    // Compound words and words with guesses are not cached as the
+    // check info for them can not be stored in a single entry.
+    if (res ? !check_inf[0].compound 
+            : !check_inf[0].word && !guess_info.head)
+      check_cache.insert(word.begin(), word.size, res, check_inf[0]);
+    trace("check", ParmString(word.begin(), word.size), res);
+    return res;
+  }
+
+  PosibErr<unsigned int> SpellerImpl::check_batch(char * words, 
+                                                  const unsigned int * sizes,
+                                                  unsigned int num,
+                                                  unsigned char * result)
+  {
+    // No guess info is collected as check_info is not available after
+    // a batch check, the result is otherwise the same as calling
+    // check on each word.
+    unsigned run_together_limit 
+      = unconditional_run_together_ ? run_together_limit_ : 0;
+    stat_add(STAT_CHECK, num);
+    memset(result, 0, (num + 7)/8);
+    unsigned int num_correct = 0;
+    char * w = words;
+    for (unsigned int i = 0; i != num; ++i) {
+      char * w_end = w + sizes[i];
+      RET_ON_ERR_SET(check(w, w_end, false, run_together_limit, 
+                           check_inf, 0), bool, res);
+      if (res) {
+        result[i/8] |= 1 << i%8;
+        ++num_correct;
+      }
+      w = w_end + 1;
+    }
+    return num_correct;
+  }
+
+  bool SpellerImpl::check_stateless(ParmString word)
+  {
+    VARARRAY(char, w, word.size() + 1);
+    memcpy(w, word.str(), word.size() + 1);
+    CheckInfo ci[8];
+    PosibErr<bool> res 
+      = check(w, w + word.size(), false,
+              unconditional_run_together_ ? run_together_limit_ : 0,
+              ci, 0);
+    return !res.has_err() && res.data;
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  //
+  // Reentrant methods
+  //
+
+  class SpellerImpl::Context : public CheckContext {
+  public:
+    StackPtr<Convert> to_internal;
+    StackPtr<Convert> from_internal;
+    CharVector word;
+    CheckInfo check_inf[8];
+    GuessInfo guess_info;
+    StackPtr<Suggest> suggest;
+  };
+
+  PosibErr<CheckContext *> SpellerImpl::new_check_context()
+  {
+    StackPtr<Context> c(new Context);
+    // The context gets its own converters, including any filters
+    // attached to them, since they keep internal buffers.
+    const char * sys_enc = lang_->charmap();
+    String user_enc = config_->retrieve("encoding");
+    RET_ON_ERR_SET(new_convert(*config_, user_enc, sys_enc, NormFrom),
+                   Convert *, to_conv);
+    c->to_internal.reset(to_conv);
+    RET_ON_ERR_SET(new_convert(*config_, sys_enc, user_enc, NormTo),
+                   Convert *, from_conv);
+    c->from_internal.reset(from_conv);
+    RET_ON_ERR(setup_filter(c->to_internal->filter, config_, 
+                            true, false, false));
+    RET_ON_ERR(setup_filter(c->from_internal->filter, config_, 
+                            false, false, true));
+    RET_ON_ERR_SET(new_default_suggest(this), Suggest *, sug);
+    c->suggest.reset(sug);
+    return c.release();
+  }
+
+  PosibErr<bool> SpellerImpl::check(const char * word, int size,
+                                    CheckContext * c0)
+  {
+    Context * c = static_cast<Context *>(c0);
+    c->word.clear();
+    c->to_internal->convert(word, size, c->word);
+    return check(MutableString(c->word.mstr(), c->word.size()), c);
+  }
+
+  PosibErr<bool> SpellerImpl::check(MutableString word, CheckContext * c0)
+  {
+    Context * c = static_cast<Context *>(c0);
+    stat_add(STAT_CHECK);
+    c->guess_info.reset();
+    RET_ON_ERR_SET(check(word.begin(), word.end(), false,
+                         unconditional_run_together_ ? run_together_limit_ : 0,
+                         c->check_inf, &c->guess_info), bool, res);
+    trace("check", ParmString(word.begin(), word.size), res);
+    return res;
+  }
+
+  const CheckInfo * SpellerImpl::check_info(CheckContext * c0)
+  {
+    Context * c = static_cast<Context *>(c0);
+    if (c->check_inf[0].word)
+      return c->check_inf;
+    else if (c->guess_info.head)
+      return c->guess_info.head;
+    else
+      return 0;
+  }
+
+  PosibErr<const WordList *> SpellerImpl::suggest(const char * word, int size,
+                                                  CheckContext * c0)
+  {
+    Context * c = static_cast<Context *>(c0);
+    c->word.clear();
+    c->to_internal->convert(word, size, c->word);
+    SuggestionList & sugs = c->suggest->suggest(c->word.mstr());
+    sugs.from_internal_ = c->from_internal;
+    return &sugs;
+  }
+
   //////////////////////////////////////////////////////////////////////
   //
   // Word list managment methods
   //
   
   PosibErr<void> SpellerImpl::save_all_word_lists() {
+    // synchronizing may merge in words added by other processes
+    check_cache.clear();
     SpellerDict * i = dicts_;
     for (; i; i = i->next) {
       if  (i->save_on_saveall)
@@ -268,6 +432,8 @@ namespace aspeller {
     Dict * w = wc->dict;
     assert(locate(w->id()) == 0);
 
+    check_cache.clear();
+
     if (!lang_) {
       lang_.copy(w->lang());
       config_->replace("lang", lang_name());
@@ -438,6 +604,7 @@ namespace aspeller {
     while (i != end) {
       if (strcmp(ki->name, i->name) == 0) {
         if (i->type == t) {
+          m->check_cache.clear();
           RET_ON_ERR(i->fun.call(m, value));
           break;
         }
@@ -504,18 +671,31 @@ namespace aspeller {
       RET_ON_ERR(add_dicts(this, to_add));
     }
 
+    RET_ON_ERR(setup_other_dicts());
+    return finish_setup();
+  }
+
+  // loads the personal, session and replacement word lists, these are
+  // never shared with other spellers
+
+  PosibErr<void> SpellerImpl::setup_other_dicts()
+  {
+    DictList to_add;
+
     bool use_other_dicts = config_->retrieve_bool("use-other-dicts");
 
     if (use_other_dicts && !personal_)
     {
       Dictionary * temp;
       temp = new_default_writable_dict();
-      PosibErrBase pe = temp->load(config_->retrieve("personal-path"),*config_);
+      PosibErrBase pe = temp->load(config_->retrieve("personal-path"),*config_,
+                                   &to_add, this);
       if (pe.has_err(cant_read_file))
         temp->set_check_lang(lang_name(), *config_);
       else if (pe.has_err())
         return pe;
       RET_ON_ERR(add_dict(new SpellerDict(temp, *config_, personal_id)));
+      RET_ON_ERR(add_dicts(this, to_add));
     }
     
     if (use_other_dicts && !session_)
@@ -537,6 +717,13 @@ namespace aspeller {
       RET_ON_ERR(add_dict(new SpellerDict(temp, *config_, personal_repl_id)));
     }
 
+    return no_err;
+  }
+
+  // everything after the dictionaries are added
+
+  PosibErr<void> SpellerImpl::finish_setup()
+  {
     const char * sys_enc = lang_->charmap();
     String user_enc = config_->retrieve("encoding");
     if (user_enc == "none") {
@@ -545,10 +732,10 @@ namespace aspeller {
     }
 
     PosibErr<Convert *> conv;
-    conv = new_convert(*c, user_enc, sys_enc, NormFrom);
+    conv = new_convert(*config_, user_enc, sys_enc, NormFrom);
     if (conv.has_err()) return conv;
     to_internal_.reset(conv);
-    conv = new_convert(*c, sys_enc, user_enc, NormTo);
+    conv = new_convert(*config_, sys_enc, user_enc, NormTo);
     if (conv.has_err()) return conv;
     from_internal_.reset(conv);
 
@@ -633,6 +820,67 @@ namespace aspeller {
     return no_err;
   }
 
+  //////////////////////////////////////////////////////////////////////
+  //
+  // SpellerImpl clone method
+  //
+
+  PosibErr<Speller *> SpellerImpl::clone() const
+  {
+    StackPtr<SpellerImpl> m(new SpellerImpl);
+    m->config_.reset(new Config(*config_));
+    m->lang_ = lang_;
+    m->ignore_repl  = ignore_repl;
+    m->ignore_count = ignore_count;
+
+    m->s_cmp        = s_cmp;
+    m->s_cmp_begin  = s_cmp_begin;
+    m->s_cmp_middle = s_cmp_middle;
+    m->s_cmp_end    = s_cmp_end;
+
+    // Share the dictionaries added before the personal, session and
+    // replacement word lists, i.e. the ones from the main and extra
+    // dictionaries.  dicts_ has the most recently added dictionary
+    // first, they are added to the clone in the original order.
+    Vector<const SpellerDict *> shared;
+    for (const SpellerDict * i = dicts_; i; i = i->next) {
+      if (i->special_id == personal_id || i->special_id == session_id
+          || i->special_id == personal_repl_id)
+        shared.clear();
+      else
+        shared.push_back(i);
+    }
+    for (unsigned i = shared.size(); i != 0; --i) {
+      SpellerDict * d = new SpellerDict(*shared[i - 1]);
+      d->dict->copy();
+      d->next = 0;
+      RET_ON_ERR(m->add_dict(d));
+    }
+
+    RET_ON_ERR(m->setup_other_dicts());
+    RET_ON_ERR(m->finish_setup());
+    return m.release();
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  //
+  // SpellerImpl memory_usage method
+  //
+
+  void SpellerImpl::memory_usage(MemReport & r) const
+  {
+    r.begin("speller");
+    r.add("object", sizeof(*this) - sizeof(CheckCache));
+    r.add("check cache", sizeof(CheckCache));
+    for (const SpellerDict * i = dicts_; i; i = i->next)
+      i->dict->memory_usage(r);
+    lang_->memory_usage(r);
+    if (suggest_) suggest_->memory_usage(r);
+    if (to_internal_) to_internal_->memory_usage(r, "to internal");
+    if (from_internal_) from_internal_->memory_usage(r, "from internal");
+    r.end();
+  }
+
   //////////////////////////////////////////////////////////////////////
   //
   // SpellerImpl destrution members
@@ -660,6 +908,7 @@ namespace aspeller {
       tok->char_type_[i].middle = lang_->special(i).middle;
       tok->char_type_[i].end    = lang_->special(i).end;
     }
+    tok->compile_char_types();
     tok->conv_ = to_internal_;
   }
 
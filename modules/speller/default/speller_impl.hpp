@@ -12,6 +12,7 @@
 #include "enumeration.hpp"
 #include "speller.hpp"
 #include "check_list.hpp"
+#include "check_cache.hpp"
 
 using namespace acommon;
 
@@ -22,7 +23,8 @@ namespace acommon {
 }
 // The speller class is responsible for keeping track of the
 // dictionaries coming up with suggestions and the like. Its methods
-// are NOT meant to be used my multiple threads and/or documents.
+// are NOT meant to be used my multiple threads and/or documents,
+// except for the reentrant methods which take a CheckContext.
 
 namespace aspeller {
 
@@ -54,6 +56,8 @@ namespace aspeller {
 
     PosibErr<void> setup(Config *);
 
+    PosibErr<Speller *> clone() const;
+
     void setup_tokenizer(Tokenizer *);
 
     //
@@ -97,12 +101,7 @@ namespace aspeller {
 			 unsigned run_together_limit,
 			 CheckInfo *, GuessInfo *);
 
-    PosibErr<bool> check(MutableString word) {
-      guess_info.reset();
-      return check(word.begin(), word.end(), false,
-		   unconditional_run_together_ ? run_together_limit_ : 0,
-		   check_inf, &guess_info);
-    }
+    PosibErr<bool> check(MutableString word);
     PosibErr<bool> check(ParmString word)
     {
       std::vector<char> w(word.size()+1);
@@ -112,6 +111,9 @@ namespace aspeller {
 
     PosibErr<bool> check(const char * word) {return check(ParmString(word));}
 
+    PosibErr<unsigned int> check_batch(char * words, const unsigned int * sizes,
+                                       unsigned int num, unsigned char * result);
+
     bool check2(char * word, /* it WILL modify word */
                 bool try_uppercase,
                 CheckInfo & ci, GuessInfo * gi);
@@ -150,6 +152,25 @@ namespace aspeller {
     PosibErr<void> store_replacement(const String & mis, const String & cor,
 				     bool memory);
 
+    //
+    // Reentrant methods, see speller.hpp
+    //
+
+    class Context;
+
+    PosibErr<CheckContext *> new_check_context();
+    PosibErr<bool> check(const char * word, int size, CheckContext *);
+    PosibErr<bool> check(MutableString word, CheckContext *);
+    const CheckInfo * check_info(CheckContext *);
+    PosibErr<const WordList *> suggest(const char * word, int size, 
+                                       CheckContext *);
+
+    // like check but does not use or change any state in the speller
+    // so it can be used by the reentrant methods
+    bool check_stateless(ParmString word);
+
+    void memory_usage(MemReport &) const;
+
     //
     // Private Stuff (from here to the end of the class)
     //
@@ -174,6 +195,9 @@ namespace aspeller {
     SpellerImpl(const SpellerImpl &other);
 
     SpellerDict * dicts_;
+
+    PosibErr<void> setup_other_dicts();
+    PosibErr<void> finish_setup();
     
     Dictionary       * personal_;
     Dictionary       * session_;
@@ -196,6 +220,10 @@ namespace aspeller {
     CheckInfo check_inf[8];
     GuessInfo guess_info;
 
+    // must be cleared whenever anything that can affect the result
+    // of check changes
+    CheckCache check_cache;
+
     SensitiveCompare s_cmp;
     SensitiveCompare s_cmp_begin;  // These (s_cmp_begin,middle,end)
     SensitiveCompare s_cmp_middle; // are used by the affix code.
@@ -574,7 +574,8 @@ namespace {
       new_word[i+1] = new_word[i];
       new_word[i] = '\0';
       
-      if (sp->check(new_word) && sp->check(new_word + i + 1)) {
+      if (sp->check_stateless(new_word) 
+          && sp->check_stateless(new_word + i + 1)) {
         for (size_t j = 0; j != parms->split_chars.size(); ++j)
         {
           new_word[i] = parms->split_chars[j];
@@ -1225,9 +1226,9 @@ namespace {
  	  dup_pair = duplicates_check.insert(fix_case(i->repl_list->word, buf));
  	  if (dup_pair.second && 
  	      ((pos = dup_pair.first->find(' '), pos == String::npos)
- 	       ? (bool)sp->check(*dup_pair.first)
- 	       : (sp->check((String)dup_pair.first->substr(0,pos)) 
- 		  && sp->check((String)dup_pair.first->substr(pos+1))) ))
+ 	       ? sp->check_stateless(*dup_pair.first)
+ 	       : (sp->check_stateless((String)dup_pair.first->substr(0,pos)) 
+ 		  && sp->check_stateless((String)dup_pair.first->substr(pos+1))) ))
  	    near_misses_final->push_back(*dup_pair.first);
  	} while (i->repl_list->adv());
       } else {
@@ -1287,6 +1288,9 @@ namespace {
       return -1;
     }
     SuggestionList & suggest(const char * word);
+    void memory_usage(MemReport & r) const {
+      if (parms_.ti) parms_.ti->memory_usage(r);
+    }
   };
   
   PosibErr<void> SuggestImpl::setup(SpellerImpl * m)
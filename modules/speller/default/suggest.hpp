@@ -7,6 +7,8 @@
 #include "enumeration.hpp"
 #include "parm_string.hpp"
 
+namespace acommon {class MemReport;}
+
 using namespace acommon;
 
 namespace aspeller {
@@ -34,6 +36,7 @@ namespace aspeller {
     virtual PosibErr<void> set_mode(ParmString) = 0;
     virtual double score(const char * base, const char * other) = 0;
     virtual SuggestionList & suggest(const char * word) = 0;
+    virtual void memory_usage(MemReport &) const {}
     virtual ~Suggest() {}
   };
   
@@ -50,6 +50,9 @@ namespace aspeller {
     typedef const Language CacheConfig2;
     typedef const char * CacheKey;
     bool cache_key_eq(const char * kb) const {return keyboard == kb;}
+    const char * cache_key_str() const {return keyboard.str();}
+    size_t cache_size() const {
+      return sizeof(*this) + (max_normalized+1)*(max_normalized+1)*2*sizeof(short);}
     static PosibErr<TypoEditDistanceInfo *> get_new(const char *, const Config *, const Language *);
   private:
     TypoEditDistanceInfo(const TypoEditDistanceInfo &);
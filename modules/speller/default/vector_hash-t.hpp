@@ -28,9 +28,10 @@ namespace aspeller {
     , key(k)
     , i(ht->hash1(k))
     , hash2(ht->hash2(k))
+    , probes(0)
   {
     if (!parms->is_nonexistent((*vector)[i])
-	&& !parms->equal(parms->key((*vector)[i]), key))
+	&& (++probes, !parms->equal(parms->key((*vector)[i]), key)))
       adv();
   }
 
@@ -39,7 +40,7 @@ namespace aspeller {
     do {
       i = (i + hash2) % vector->size();
     } while (!parms->is_nonexistent((*vector)[i])
-	     && !parms->equal(parms->key((*vector)[i]), key));
+	     && (++probes, !parms->equal(parms->key((*vector)[i]), key)));
   }
 
   template<class Parms>
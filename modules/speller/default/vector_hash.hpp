@@ -232,6 +232,9 @@ namespace aspeller {
   
     size_type size() const {return size_;}
     bool      empty() const {return !size_;}
+    void      clear() {
+      vector_.clear(); vector_.resize(19); size_ = 0; nonexistent_vector();
+    }
 
     void swap(VectorHashTable &);
     void resize(size_type);
@@ -247,6 +250,7 @@ namespace aspeller {
       key_type key;
       int i;
       int hash2;
+      unsigned probes; // entries compared with key so far
       FindIterator() {}
       FindIterator(const HashTable * ht, const key_type & k);
     public:
@@ -4,9 +4,18 @@
 // LGPL license along with this library if you did not you can find it
 // at http://www.gnu.org/.
 
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-#include "hash-t.hpp"
+#ifndef WIN32
+#  include <dirent.h>
+#  include <errno.h>
+#  include <signal.h>
+#  include <unistd.h>
+#endif
+
+#include "config.hpp"
 #include "data.hpp"
 #include "data_util.hpp"
 #include "enumeration.hpp"
@@ -14,7 +23,13 @@
 #include "file_util.hpp"
 #include "fstream.hpp"
 #include "language.hpp"
+#include "lock.hpp"
+#include "mem_report.hpp"
 #include "getdata.hpp"
+#include "hash_fun.hpp"
+#include "stack_ptr.hpp"
+#include "thread.hpp"
+#include "vector_hash-t.hpp"
 
 namespace {
 
@@ -88,10 +103,63 @@ bool getline_n_unescape(FStream & in, DataPair & d, String & buf)
   return true;
 }
 
-typedef Vector<Str> StrVector;
+// All words and soundslikes are allocated from a single ObjStack and
+// indexed by open address hash tables which store the hash value
+// next to the pointer, so that most probes do not need to look at the
+// string itself and the tables never need to rehash a string when
+// growing.  Words with the same soundslike and the replacements for
+// a misspelling are kept in singly linked lists whose links are
+// stored in the ObjStack right before the word, so there are no
+// per-entry heap allocations.
+
+struct HashedStr {
+  Str str;
+  size_t hash;
+  HashedStr() {}
+  HashedStr(Str s, size_t h) : str(s), hash(h) {}
+};
 
-typedef hash_multiset<Str,Hash,Equal> WordLookup;
-typedef hash_map<Str,StrVector>  SoundslikeLookup;
+struct WordLookupParms {
+  typedef acommon::Vector<HashedStr> Vector;
+  typedef HashedStr                  Value;
+  typedef HashedStr                  Key;
+  static const bool is_multi = true;
+  Equal eq;
+  WordLookupParms(const Language * l) : eq(l) {}
+  size_t hash(const Key & k) const {return k.hash;}
+  bool equal(const Key & x, const Key & y) const {
+    return x.hash == y.hash && eq(x.str, y.str);
+  }
+  const Key & key(const Value & v) const {return v;}
+  bool is_nonexistent(const Value & v) const {return v.str == 0;}
+  void make_nonexistent(Value & v) const {v.str = 0;}
+};
+
+struct SoundslikeLookupParms {
+  typedef acommon::Vector<HashedStr> Vector;
+  typedef HashedStr                  Value;
+  typedef HashedStr                  Key;
+  static const bool is_multi = false;
+  size_t hash(const Key & k) const {return k.hash;}
+  bool equal(const Key & x, const Key & y) const {
+    return x.hash == y.hash && strcmp(x.str, y.str) == 0;
+  }
+  const Key & key(const Value & v) const {return v;}
+  bool is_nonexistent(const Value & v) const {return v.str == 0;}
+  void make_nonexistent(Value & v) const {v.str = 0;}
+};
+
+typedef VectorHashTable<WordLookupParms>       WordLookup;
+typedef VectorHashTable<SoundslikeLookupParms> SoundslikeLookup;
+
+// New entries are normally appended to the end of the file when
+// saving rather than rewriting the whole file, which is only done
+// when the file needs to be converted or has too many redundant
+// entries.  Before appending, the entries other processes appended
+// since the file was last read are merged in.  If the file was
+// rewritten by another process, which is detected by the first line
+// or the size changing, it is merged in full and rewritten as
+// before.
 
 class WritableBase : public Dictionary {
 protected:
@@ -99,19 +167,33 @@ protected:
   String compatibility_suffix;
     
   time_t cur_file_date;
+  long   cur_file_size;
+  String cur_file_header;
+  bool   can_append;     // if the file is in the current format
+  unsigned file_entries; // number of entries in the file
+  bool   loading;        // if the entries being added are from the file
   
   String compatibility_file_name;
     
   WritableBase(BasicType t, const char * n, const char * s, const char * cs)
     : Dictionary(t,n),
       suffix(s), compatibility_suffix(cs),
+      cur_file_date(0), cur_file_size(0), can_append(false), 
+      file_entries(0), loading(false),
       use_soundslike(true) {fast_lookup = true;}
   virtual ~WritableBase() {}
   
   virtual PosibErr<void> save(FStream &, ParmString) = 0;
   virtual PosibErr<void> merge(FStream &, ParmString, Config * = 0) = 0;
+  // reads the entries of a file in the current format which follow
+  // the header
+  virtual PosibErr<void> merge_entries(FStream &, ParmString) = 0;
+  // appends the entries added since the last save
+  virtual void save_unsaved(FStream &) = 0;
+  virtual void clear_unsaved() = 0;
     
   PosibErr<void> save2(FStream &, ParmString);
+  PosibErr<void> load_merge(FStream &, ParmString, Config * = 0);
   PosibErr<void> update(FStream &, ParmString);
   PosibErr<void> save(bool do_update);
   PosibErr<void> update_file_date_info(FStream &);
@@ -132,19 +214,55 @@ protected:
   StackPtr<WordLookup> word_lookup;
   SoundslikeLookup     soundslike_lookup_;
   ObjStack             buffer;
+
+  const WordLookup & words() const {return *word_lookup;}
+  HashedStr word_key(ParmString w) const {
+    return HashedStr(w, Hash(lang())(w));
+  }
+  // links the word into the list of words with the soundslike
+  void add_soundslike(Str word, ParmString sl);
+  // adds the hash tables and words to the report
+  void add_memory_usage(MemReport &) const;
  
   void set_lang_hook(Config & c) {
     set_file_encoding(lang()->data_encoding(), c);
-    word_lookup.reset(new WordLookup(10, Hash(lang()), Equal(lang())));
+    word_lookup.reset(new WordLookup(WordLookupParms(lang())));
     use_soundslike = lang()->have_soundslike();
   }
 };
 
+void WritableBase::add_memory_usage(MemReport & r) const
+{
+  r.add("object", sizeof(*this));
+  if (word_lookup)
+    r.add("word hash table", 
+          word_lookup->vector().capacity() * sizeof(HashedStr));
+  r.add("soundslike hash table", 
+        soundslike_lookup_.vector().capacity() * sizeof(HashedStr));
+  r.add("words", buffer.calc_size());
+}
+
 PosibErr<void> WritableBase::update_file_date_info(FStream & f) {
   RET_ON_ERR(update_file_info(f));
   cur_file_date = get_modification_time(f);
+  f.seek(0);
+  cur_file_header.clear();
+  f.append_line(cur_file_header, '\n');
+  f.seek(0, SEEK_END);
+  cur_file_size = f.tell();
   return no_err;
 }
+
+// Like merge, but the entries are not remembered as unsaved since
+// they are already in the file.
+PosibErr<void> WritableBase::load_merge(FStream & in, ParmString file_name, 
+                                        Config * config) {
+  loading = true;
+  file_entries = 0;
+  PosibErr<void> pe = merge(in, file_name, config);
+  loading = false;
+  return pe;
+}
   
 PosibErr<void> WritableBase::load(ParmString f0, Config & config,
                                   DictList *, SpellerImpl *)
@@ -158,7 +276,7 @@ PosibErr<void> WritableBase::load(ParmString f0, Config & config,
     RET_ON_ERR(open_file_readlock(in, f));
     if (in.peek() == EOF) return make_err(cant_read_file,f); 
     // ^^ FIXME 
-    RET_ON_ERR(merge(in, f, &config));
+    RET_ON_ERR(load_merge(in, f, &config));
       
   } else if (f.substr(f.size()-suffix.size(),suffix.size()) 
              == suffix) {
@@ -170,7 +288,7 @@ PosibErr<void> WritableBase::load(ParmString f0, Config & config,
       PosibErr<void> pe = open_file_readlock(in, compatibility_file_name);
       if (pe.has_err()) {compatibility_file_name = ""; return pe;}
     } {
-      PosibErr<void> pe = merge(in, compatibility_file_name, &config);
+      PosibErr<void> pe = load_merge(in, compatibility_file_name, &config);
       if (pe.has_err()) {compatibility_file_name = ""; return pe;}
     }
       
@@ -194,7 +312,7 @@ PosibErr<void> WritableBase::merge(ParmString f0) {
 PosibErr<void> WritableBase::update(FStream & in, ParmString fn) {
   typedef PosibErr<void> Ret;
   {
-    Ret pe = merge(in, fn);
+    Ret pe = load_merge(in, fn);
     if (pe.has_err() && compatibility_file_name.empty()) return pe;
   } {
     Ret pe = update_file_date_info(in);
@@ -210,6 +328,10 @@ PosibErr<void> WritableBase::save2(FStream & out, ParmString fn) {
 
   out.flush();
 
+  clear_unsaved();
+  can_append = true;
+  file_entries = size();
+
   return no_err;
 }
 
@@ -228,12 +350,42 @@ PosibErr<void> WritableBase::save(bool do_update) {
   RET_ON_ERR_SET(open_file_writelock(inout, file_name()),
                  bool, prev_existed);
 
-  if (do_update
-      && prev_existed 
-      && get_modification_time(inout) > cur_file_date)
-    RET_ON_ERR(update(inout, file_name()));
+  bool append = prev_existed && can_append 
+    && compatibility_file_name.empty();
+  if (append) {
+    String header;
+    inout.append_line(header, '\n');
+    inout.seek(0, SEEK_END);
+    long size = inout.tell();
+    append = header == cur_file_header && size >= cur_file_size;
+    if (append && size > cur_file_size) {
+      inout.seek(cur_file_size - 1);
+      append = inout.get() == '\n';
+      if (append && do_update) {
+        loading = true;
+        PosibErr<void> pe = merge_entries(inout, file_name());
+        loading = false;
+        if (pe.has_err()) return pe;
+      }
+    }
+    inout.seek(0);
+  }
 
-  RET_ON_ERR(save2(inout, file_name()));
+  if (!append) {
+    if (do_update
+        && prev_existed 
+        && get_modification_time(inout) > cur_file_date)
+      RET_ON_ERR(update(inout, file_name()));
+    RET_ON_ERR(save2(inout, file_name()));
+  } else if (file_entries > 2 * size() + 64) {
+    // too many entries were added more than once by different
+    // processes
+    RET_ON_ERR(save2(inout, file_name()));
+  } else {
+    inout.seek(0, SEEK_END);
+    save_unsaved(inout);
+    inout.flush();
+  }
   RET_ON_ERR(update_file_date_info(inout));
     
   if (compatibility_file_name.size() != 0) {
@@ -245,6 +397,8 @@ PosibErr<void> WritableBase::save(bool do_update) {
 }
 
 PosibErr<void> WritableBase::clear() {
+  clear_unsaved();
+  can_append = false;
   word_lookup->clear();
   soundslike_lookup_.clear();
   buffer.reset();
@@ -271,8 +425,28 @@ PosibErr<void> WritableBase::set_file_encoding(ParmString enc, Config & c)
 //
 
 // a word is stored in memory as follows
-//   <word info><size><word...><null>
-// the hash table points to the word and not the start of the block
+//   <next word><word info><size><word...><null>
+// where next word is the next word in the list the word is in, the
+// block is aligned so that the pointer is.  The hash table points to
+// the word and not the start of the block
+
+static inline Str & next_word(Str w)
+{
+  return *(Str *)(w - 2 - sizeof(Str));
+}
+
+static inline char * alloc_word(ObjStack & buf, ParmString w, byte info,
+                                unsigned extra = 0)
+{
+  extra += sizeof(Str);
+  byte * w2 = (byte *)buf.alloc(extra + w.size() + 3, sizeof(void *));
+  memset(w2, 0, extra);
+  w2 += extra;
+  *w2++ = info;
+  *w2++ = w.size();
+  memcpy(w2, w.str(), w.size() + 1);
+  return (char *)w2;
+}
 
 static inline void set_word(WordEntry & res, Str w)
 {
@@ -283,37 +457,60 @@ static inline void set_word(WordEntry & res, Str w)
 }
 
 // a soundslike is stored in memory as follows
-//   <word info><size><sl...><null>
+//   <first word><last word><size><sl...><null>
 // the hash table points to the sl and not the start of the block
 
+static inline Str & first_word(Str sl)
+{
+  return *(Str *)(sl - 1 - 2*sizeof(Str));
+}
+
+static inline Str & last_word(Str sl)
+{
+  return *(Str *)(sl - 1 - sizeof(Str));
+}
+
 static inline void set_sl(WordEntry & res, Str w)
 {
   res.word      = w;
   res.word_size = (byte)w[-1];
 }
 
-static void soundslike_next(WordEntry * w)
+void WritableBase::add_soundslike(Str w, ParmString sl)
 {
-  const Str * & i   = (const Str * &)(w->intr[0]);
-  const Str *   end = (const Str *  )(w->intr[1]);
-  set_word(*w, *i);
-  ++i;
-  if (i == end) w->adv_ = 0;
+  HashedStr key(sl, acommon::hash<const char *>()(sl));
+  SoundslikeLookup::iterator i = soundslike_lookup_.find(key);
+  if (i == soundslike_lookup_.end()) {
+    byte * s2 = (byte *)buffer.alloc(2*sizeof(Str) + sl.size() + 2, 
+                                     sizeof(void *));
+    Str * l = (Str *)s2;
+    l[0] = w;
+    l[1] = w;
+    s2 += 2*sizeof(Str);
+    *s2++ = sl.size();
+    memcpy(s2, sl.str(), sl.size() + 1);
+    key.str = (char *)s2;
+    soundslike_lookup_.insert(key);
+  } else {
+    Str & last = last_word(i->str);
+    next_word(last) = w;
+    last = w;
+  }
 }
 
-static void sl_init(const StrVector * tmp, WordEntry & o)
+// the intr[0] of a word entry which walks a list is the next word
+static void list_next(WordEntry * w)
 {
-  const Str * i   = tmp->pbegin();
-  const Str * end = tmp->pend();
-  set_word(o, *i);
-  ++i;
-  if (i != end) {
-    o.intr[0] = (void *)i;
-    o.intr[1] = (void *)end;
-    o.adv_ = soundslike_next;
-  } else {
-    o.intr[0] = 0;
-  }
+  set_word(*w, (Str)w->intr[0]);
+  w->intr[0] = (void *)next_word(w->word);
+  if (!w->intr[0]) w->adv_ = 0;
+}
+
+static void list_init(Str first, WordEntry & o)
+{
+  set_word(o, first);
+  o.intr[0] = (void *)next_word(first);
+  if (o.intr[0]) o.adv_ = list_next;
 }
 
 struct SoundslikeElements : public SoundslikeEnumeration {
@@ -331,8 +528,7 @@ struct SoundslikeElements : public SoundslikeEnumeration {
 
   WordEntry * next(int) {
     if (i == end) return 0;
-    set_sl(d, i->first);
-    d.intr[0] = (void *)(&i->second);
+    set_sl(d, i->str);
     ++i;
     return &d;
   }
@@ -353,7 +549,7 @@ struct CleanElements : public SoundslikeEnumeration {
 
   WordEntry * next(int) {
     if (i == end) return 0;
-    set_word(d, *i);
+    set_word(d, i->str);
     ++i;
     return &d;
   }
@@ -366,10 +562,187 @@ struct ElementsParms {
   WordEntry data;
   ElementsParms(Iterator e) : end_(e) {}
   bool endf(Iterator i) const {return i==end_;}
-  Value deref(Iterator i) {set_word(data, *i); return &data;}
+  Value deref(Iterator i) {set_word(data, i->str); return &data;}
   static Value end_state() {return 0;}
 };
 
+/////////////////////////////////////////////////////////////////////
+// 
+//  Snapshots
+//
+
+// Large personal word lists are compiled into a read only dictionary,
+// the snapshot, which is stored next to the list with ".rws" added to
+// the name.  The size and a checksum of the part of the file it
+// covers, as well as the first line, are stored in the dict name.
+// Since new entries are appended to the file, only the entries after
+// that part need to be read when the list is loaded, the snapshot is
+// simply mapped into memory and added to the speller as a separate
+// dictionary.  If the file was changed in any other way the snapshot
+// is not used.
+
+static unsigned long checksum(FStream & in, long size)
+{
+  unsigned long sum = 0;
+  char buf[8192];
+  in.seek(0);
+  while (size > 0) {
+    unsigned int n = size < (long)sizeof(buf) ? size : sizeof(buf);
+    if (!in.read(buf, n)) return ~sum;
+    for (const char * i = buf; i != buf + n; ++i)
+      sum = (33 * sum + (unsigned char)*i) & 0xFFFFFFFF;
+    size -= n;
+  }
+  return sum;
+}
+
+struct PackedWords : public StringEnumeration {
+  const char * cur;
+  const char * end;
+  PackedWords(const char * b, const char * e) : cur(b), end(e) {}
+  bool at_end() const {return cur == end;}
+  const char * next() {
+    if (cur == end) return 0;
+    const char * w = cur;
+    cur += strlen(cur) + 1;
+    return w;
+  }
+  StringEnumeration * clone() const {return new PackedWords(*this);}
+  void assign(const StringEnumeration * other) {
+    *this = *static_cast<const PackedWords *>(other);
+  }
+};
+
+// The snapshot is compiled in a separate thread so that loading the
+// list is not slowed down.
+struct SnapshotBuilder {
+  StackPtr<Config> config;
+  CharVector words; // null terminated, in the internal encoding
+  String file_name;
+  String dict_name;
+  long size;         // the part of the list compiled
+  unsigned long sum; //   and its checksum
+  Thread thread;
+  static void * run(void *);
+};
+
+// The lists whose snapshot could not be written, for example because
+// the directory is read only or the disk is full, with the size and
+// checksum they had then.  The build is not tried again until the
+// list changed.
+
+struct FailedSnapshot {
+  String file_name;
+  long size;
+  unsigned long sum;
+};
+
+static Mutex failed_snapshots_lock;
+static Vector<FailedSnapshot> failed_snapshots;
+
+static bool snapshot_failed(const String & file_name, 
+                            long size, unsigned long sum)
+{
+  LOCK(&failed_snapshots_lock);
+  Vector<FailedSnapshot>::const_iterator i = failed_snapshots.begin();
+  for (; i != failed_snapshots.end(); ++i)
+    if (i->file_name == file_name)
+      return i->size == size && i->sum == sum;
+  return false;
+}
+
+static void set_snapshot_failed(const String & file_name,
+                                long size, unsigned long sum)
+{
+  LOCK(&failed_snapshots_lock);
+  Vector<FailedSnapshot>::iterator i = failed_snapshots.begin();
+  for (; i != failed_snapshots.end(); ++i)
+    if (i->file_name == file_name) break;
+  if (i == failed_snapshots.end()) {
+    failed_snapshots.push_back(FailedSnapshot());
+    i = failed_snapshots.end() - 1;
+    i->file_name = file_name;
+  }
+  i->size = size;
+  i->sum = sum;
+}
+
+// Removes the temporary files, "<snapshot>.<pid>.<address>", of
+// builders in processes which are no longer running, since a process
+// killed during a build leaves its file behind.  On Windows the
+// names have no process id and so are left alone.
+
+static void remove_stale_snapshots(const String & file_name)
+{
+#ifndef WIN32
+  const char * slash = strrchr(file_name.str(), '/');
+  String dir = slash ? String(file_name.str(), slash + 1 - file_name.str()) 
+                     : String();
+  String prefix = slash ? slash + 1 : file_name.str();
+  prefix += '.';
+  DIR * d = opendir(dir.empty() ? "." : dir.str());
+  if (!d) return;
+  struct dirent * entry;
+  while ((entry = readdir(d)) != 0) {
+    const char * name = entry->d_name;
+    if (strncmp(name, prefix.str(), prefix.size()) != 0) continue;
+    const char * num = name + prefix.size();
+    char * end;
+    long pid = strtol(num, &end, 10);
+    if (end == num || *end != '.' || pid <= 0) continue;
+    if (kill(pid, 0) == 0 || errno != ESRCH) continue;
+    remove_file(dir + name);
+  }
+  closedir(d);
+#endif
+}
+
+void * SnapshotBuilder::run(void * d)
+{
+  SnapshotBuilder * b = static_cast<SnapshotBuilder *>(d);
+  remove_stale_snapshots(b->file_name);
+  // several builders, in this or another process, may be running at
+  // once so the temporary file name must be unique
+  String tmp = b->file_name;
+#ifdef WIN32
+  tmp.printf(".%p", d);
+#else
+  tmp.printf(".%d.%p", (int)getpid(), d);
+#endif
+  b->config->replace("master-path", tmp);
+  PosibErrBase pe = create_default_readonly_dict
+    (new PackedWords(b->words.pbegin(), b->words.pend()),
+     *b->config, b->dict_name);
+  if (pe.has_err() || !rename_file(tmp, b->file_name)) {
+    remove_file(tmp);
+    set_snapshot_failed(b->file_name, b->size, b->sum);
+  }
+  pe.ignore_err();
+  return 0;
+}
+
+struct ChainElements : public WordEntryEnumeration {
+  ClonePtr<WordEntryEnumeration> first;
+  ClonePtr<WordEntryEnumeration> second;
+  ChainElements(WordEntryEnumeration * f, WordEntryEnumeration * s)
+    : first(f), second(s) {}
+  WordEntryEnumeration * clone() const {return new ChainElements(*this);}
+  void assign(const WordEntryEnumeration * other) {
+    *this = *static_cast<const ChainElements *>(other);
+  }
+  WordEntry * next() {
+    if (first) {
+      WordEntry * w = first->next();
+      if (w) return w;
+      first.reset(0);
+    }
+    return second->next();
+  }
+  bool at_end() const {
+    return (!first || first->at_end()) && second->at_end();
+  }
+};
+
 /////////////////////////////////////////////////////////////////////
 // 
 //  WritableDict
@@ -377,13 +750,36 @@ struct ElementsParms {
 
 class WritableDict : public WritableBase
 {
+  Vector<Str> unsaved;
+  PosibErr<void> merge_entries(FStream &, ParmString, unsigned int ver);
+
+  CachePtr<Dictionary> snapshot;
+  unsigned int snapshot_min; // 0 if snapshots are not used
+  bool first_load;           // if the file is being loaded by load
+  long loaded_size;          // the part of the file which was loaded
+  unsigned long loaded_sum;  //   and its checksum, if it is large enough
+  StackPtr<SnapshotBuilder> builder;
+  String snapshot_file_name() const {return String(file_name()) + ".rws";}
+  void open_snapshot(Config &);
+  void skip_snapshot(FStream &);
+  void build_snapshot(Config &);
+
 public: //but don't use
   PosibErr<void> save(FStream &, ParmString);
   PosibErr<void> merge(FStream &, ParmString, Config * config);
+  PosibErr<void> merge_entries(FStream & in, ParmString file_name) {
+    return merge_entries(in, file_name, 11);}
+  void save_unsaved(FStream &);
+  void clear_unsaved() {unsaved.clear();}
 
 public:
 
-  WritableDict() : WritableBase(basic_dict, "WritableDict", ".pws", ".per") {}
+  WritableDict() : WritableBase(basic_dict, "WritableDict", ".pws", ".per"),
+                   snapshot_min(0), first_load(false), 
+                   loaded_size(0), loaded_sum(0) {}
+
+  PosibErr<void> load(ParmString, Config &, DictList *, SpellerImpl *);
+  PosibErr<void> clear();
 
   Size   size()     const;
   bool   empty()    const;
@@ -401,30 +797,153 @@ public:
   WordEntryEnumeration * detailed_elements() const;
 
   SoundslikeEnumeration * soundslike_elements() const;
+
+  void memory_usage(MemReport &) const;
 };
 
+void WritableDict::memory_usage(MemReport & r) const
+{
+  r.begin(file_name()[0] ? file_name() : class_name);
+  add_memory_usage(r);
+  // the snapshot is reported by the speller as a dictionary of its own
+  r.add("unsaved", unsaved.capacity() * sizeof(Str));
+  r.end();
+}
+
 WritableDict::Size WritableDict::size() const 
 {
-  return word_lookup->size();
+  return word_lookup->size() + (snapshot ? snapshot->size() : 0);
 }
 
 bool WritableDict::empty() const 
 {
-  return word_lookup->empty();
+  return word_lookup->empty() && (!snapshot || snapshot->empty());
+}
+
+// The snapshot is only used when the list is loaded for a speller,
+// i.e. when there is somewhere to add it.
+
+PosibErr<void> WritableDict::load(ParmString f0, Config & config,
+                                  DictList * others, SpellerImpl * sp)
+{
+  snapshot_min = 0;
+  loaded_size = 0;
+  if (others) {
+    int min = config.retrieve_int("personal-snapshot");
+    if (min > 0) snapshot_min = min;
+  }
+  if (snapshot_min) {
+    set_file_name(f0);
+    open_snapshot(config);
+    first_load = true;
+  }
+  PosibErr<void> pe = WritableBase::load(f0, config, others, sp);
+  first_load = false;
+  if (pe.has_err()) {
+    snapshot.reset(0);
+    return pe;
+  }
+  if (snapshot) {
+    snapshot->copy();
+    others->add(snapshot);
+  }
+  if (loaded_size > 0)
+    build_snapshot(config);
+  return no_err;
+}
+
+PosibErr<void> WritableDict::clear()
+{
+  // the speller may still have the snapshot, but a personal word list
+  // is only cleared when it could not be read
+  snapshot.reset(0);
+  return WritableBase::clear();
+}
+
+void WritableDict::open_snapshot(Config & config)
+{
+  String fn = snapshot_file_name();
+  if (!file_exists(fn)) return;
+  PosibErr<Dict *> res = add_data_set(fn, config, 0, 0, 0, DT_ReadOnly);
+  if (res.has_err()) {
+    res.ignore_err();
+    return;
+  }
+  snapshot.reset(res.data);
+}
+
+// Skips the part of the file in the snapshot, if the file no longer
+// starts with what was compiled into the snapshot it is not used.
+void WritableDict::skip_snapshot(FStream & in)
+{
+  long pos = in.tell();
+  const char * name = readonly_dict_name(snapshot);
+  char * end;
+  long size = strtol(name, &end, 10);
+  unsigned long sum = strtoul(end, &end, 10);
+  if (*end == ' ') ++end;
+  String header;
+  in.seek(0);
+  in.append_line(header, '\n');
+  in.seek(0, SEEK_END);
+  bool ok = can_append && size > 0 && header == end && in.tell() >= size;
+  if (ok) {
+    in.seek(size - 1);
+    ok = in.get() == '\n' && checksum(in, size) == sum;
+  }
+  if (ok) {
+    file_entries += snapshot->size();
+  } else {
+    snapshot.reset(0);
+    in.seek(pos);
+  }
+}
+
+void WritableDict::build_snapshot(Config & config)
+{
+  if (builder) return;
+  if (snapshot_failed(snapshot_file_name(), loaded_size, loaded_sum)) return;
+  bool have_affix = lang()->have_affix();
+  StackPtr<SnapshotBuilder> b(new SnapshotBuilder);
+  if (snapshot) {
+    StackPtr<WordEntryEnumeration> els(snapshot->detailed_elements());
+    WordEntry * w;
+    while ((w = els->next()) != 0)
+      b->words.append(w->word, w->word_size + 1);
+  }
+  WordLookup::const_iterator i = words().begin();
+  WordLookup::const_iterator e = words().end();
+  for (; i != e; ++i) {
+    // a word with a '/' would be read as having affix flags
+    if (have_affix && strchr(i->str, '/')) return;
+    b->words.append(i->str, (byte)i->str[-1] + 1);
+  }
+  b->file_name = snapshot_file_name();
+  b->size = loaded_size;
+  b->sum = loaded_sum;
+  b->dict_name.printf("%ld %lu %s", loaded_size, loaded_sum,
+                      cur_file_header.c_str());
+  b->config.reset(config.clone());
+  b->config->replace("lang", lang_name());
+  b->config->replace("encoding", lang()->charmap());
+  b->config->replace("skip-invalid-words", "false");
+  b->config->replace("clean-words", "false");
+  b->config->replace("warn", "false");
+  builder.reset(b.release());
+  builder->thread.start(SnapshotBuilder::run, builder);
 }
 
 bool WritableDict::lookup(ParmString word, const SensitiveCompare * c,
                           WordEntry & o) const
 {
   o.clear();
-  pair<WordLookup::iterator, WordLookup::iterator> p(word_lookup->equal_range(word));
-  while (p.first != p.second) {
-    if ((*c)(word,*p.first)) {
+  WordLookup::ConstFindIterator i = words().multi_find(word_key(word));
+  for (; !i.at_end(); i.adv()) {
+    if ((*c)(word,i.deref().str)) {
       o.what = WordEntry::Word;
-      set_word(o, *p.first);
+      set_word(o, i.deref().str);
       return true;
     }
-    ++p.first;
   }
   return false;
 }
@@ -432,10 +951,10 @@ bool WritableDict::lookup(ParmString word, const SensitiveCompare * c,
 bool WritableDict::clean_lookup(const char * sl, WordEntry & o) const
 {
   o.clear();
-  pair<WordLookup::iterator, WordLookup::iterator> p(word_lookup->equal_range(sl));
-  if (p.first == p.second) return false;
+  WordLookup::ConstFindIterator i = words().multi_find(word_key(sl));
+  if (i.at_end()) return false;
   o.what = WordEntry::Word;
-  set_word(o, *p.first);
+  set_word(o, i.deref().str);
   return true;
   // FIXME: Deal with multiple entries
 }  
@@ -444,12 +963,10 @@ bool WritableDict::soundslike_lookup(const WordEntry & word, WordEntry & o) cons
 {
   if (use_soundslike) {
 
-    const StrVector * tmp 
-      = (const StrVector *)(word.intr[0]);
     o.clear();
 
     o.what = WordEntry::Word;
-    sl_init(tmp, o);
+    list_init(first_word(word.word), o);
 
   } else {
       
@@ -468,12 +985,13 @@ bool WritableDict::soundslike_lookup(ParmString word, WordEntry & o) const
   if (use_soundslike) {
 
     o.clear();
-    SoundslikeLookup::const_iterator i = soundslike_lookup_.find(word);
+    SoundslikeLookup::const_iterator i 
+      = soundslike_lookup_.find(HashedStr(word, acommon::hash<const char *>()(word)));
     if (i == soundslike_lookup_.end()) {
       return false;
     } else {
       o.what = WordEntry::Word;
-      sl_init(&i->second, o);
+      list_init(first_word(i->str), o);
       return true;
     }
   
@@ -489,13 +1007,16 @@ SoundslikeEnumeration * WritableDict::soundslike_elements() const {
     return new SoundslikeElements(soundslike_lookup_.begin(), 
                                   soundslike_lookup_.end());
   else
-    return new CleanElements(word_lookup->begin(),
-                             word_lookup->end());
+    return new CleanElements(words().begin(),
+                             words().end());
 }
 
 WritableDict::Enum * WritableDict::detailed_elements() const {
-  return new MakeEnumeration<ElementsParms>
-    (word_lookup->begin(),ElementsParms(word_lookup->end()));
+  Enum * els = new MakeEnumeration<ElementsParms>
+    (words().begin(),ElementsParms(words().end()));
+  if (snapshot)
+    els = new ChainElements(snapshot->detailed_elements(), els);
+  return els;
 }
 
 PosibErr<void> WritableDict::add(ParmString w, ParmString s) {
@@ -503,19 +1024,13 @@ PosibErr<void> WritableDict::add(ParmString w, ParmString s) {
   SensitiveCompare c(lang());
   WordEntry we;
   if (WritableDict::lookup(w,&c,we)) return no_err;
-  byte * w2;
-  w2 = (byte *)buffer.alloc(w.size() + 3);
-  *w2++ = lang()->get_word_info(w);
-  *w2++ = w.size();
-  memcpy(w2, w.str(), w.size() + 1);
-  word_lookup->insert((char *)w2);
-  if (use_soundslike) {
-    byte * s2;
-    s2 = (byte *)buffer.alloc(s.size() + 2);
-    *s2++ = s.size();
-    memcpy(s2, s.str(), s.size() + 1);
-    soundslike_lookup_[(char *)s2].push_back((char *)w2);
-  }
+  if (snapshot && snapshot->lookup(w,&c,we)) return no_err;
+  Str w2 = alloc_word(buffer, w, lang()->get_word_info(w));
+  word_lookup->insert(HashedStr(w2, word_key(w).hash));
+  if (!loading)
+    unsaved.push_back(w2);
+  if (use_soundslike)
+    add_soundslike(w2, s);
   return no_err;
 }
 
@@ -554,18 +1069,49 @@ PosibErr<void> WritableDict::merge(FStream & in,
     set_file_encoding(dp.key, *config);
   else
     set_file_encoding("", *config);
+
+  if (loading)
+    can_append = ver == 11;
+
+  bool initial_load = first_load;
+  first_load = false;
+  if (initial_load && snapshot)
+    skip_snapshot(in);
   
+  Ret pe = merge_entries(in, file_name, ver);
+  if (pe.has_err()) {
+    clear();
+    return pe;
+  }
+
+  // remember what was loaded in case the snapshot needs to be rebuilt
+  loaded_size = 0;
+  if (initial_load && can_append && word_lookup->size() >= snapshot_min) {
+    in.seek(0, SEEK_END);
+    loaded_size = in.tell();
+    loaded_sum = checksum(in, loaded_size);
+  }
+  return no_err;
+}
+
+PosibErr<void> WritableDict::merge_entries(FStream & in, 
+                                           ParmString file_name,
+                                           unsigned int ver)
+{
+  typedef PosibErr<void> Ret;
+  String buf;
+  DataPair dp;
   ConvP conv(iconv);
   while (getline_n_unescape(in, dp, buf)) {
     if (ver == 10)
       split(dp);
     else
       dp.key = dp.value;
+    if (loading)
+      ++file_entries;
     Ret pe = add(conv(dp.key));
-    if (pe.has_err()) {
-      clear();
+    if (pe.has_err())
       return pe.with_file(file_name);
-    }
   }
   return no_err;
 }
@@ -573,27 +1119,57 @@ PosibErr<void> WritableDict::merge(FStream & in,
 PosibErr<void> WritableDict::save(FStream & out, ParmString file_name) 
 {
   out.printf("personal_ws-1.1 %s %i %s\n", 
-             lang_name(), word_lookup->size(), file_encoding.c_str());
+             lang_name(), size(), file_encoding.c_str());
 
-  WordLookup::const_iterator i = word_lookup->begin();
-  WordLookup::const_iterator e = word_lookup->end();
-    
   ConvP conv(oconv);
+  if (snapshot) {
+    StackPtr<WordEntryEnumeration> els(snapshot->detailed_elements());
+    WordEntry * w;
+    while ((w = els->next()) != 0) {
+      write_n_escape(out, conv(w->word));
+      out << '\n';
+    }
+  }
+
+  WordLookup::const_iterator i = words().begin();
+  WordLookup::const_iterator e = words().end();
+    
   for (;i != e; ++i) {
-    write_n_escape(out, conv(*i));
+    write_n_escape(out, conv(i->str));
     out << '\n';
   }
   return no_err;
 }
 
+void WritableDict::save_unsaved(FStream & out)
+{
+  ConvP conv(oconv);
+  for (Vector<Str>::iterator i = unsaved.begin(); i != unsaved.end(); ++i) {
+    write_n_escape(out, conv(*i));
+    out << '\n';
+  }
+  file_entries += unsaved.size();
+  unsaved.clear();
+}
+
 /////////////////////////////////////////////////////////////////////
 // 
 //  WritableReplList
 //
 
-static inline StrVector * get_vector(Str s) 
+// a misspelling is stored in memory as follows
+//   <first repl><last repl><next word><word info><size><word...><null>
+// and the replacements as normal words, the next word of a
+// replacement is the next replacement for the same misspelling
+
+static inline Str & first_repl(Str mis)
+{
+  return *(Str *)(mis - 2 - 3*sizeof(Str));
+}
+
+static inline Str & last_repl(Str mis)
 {
-  return (StrVector *)(s - sizeof(StrVector) - 2);
+  return *(Str *)(mis - 2 - 2*sizeof(Str));
 }
 
 class WritableReplDict : public WritableBase
@@ -601,12 +1177,17 @@ class WritableReplDict : public WritableBase
   WritableReplDict(const WritableReplDict&);
   WritableReplDict& operator=(const WritableReplDict&);
 
+  struct Repl {
+    Str mis;
+    Str cor;
+  };
+  Vector<Repl> unsaved;
+
 public:
   WritableReplDict() : WritableBase(replacement_dict, "WritableReplDict", ".prepl",".rpl") 
   {
     fast_lookup = true;
   }
-  ~WritableReplDict();
 
   Size   size()     const;
   bool   empty()    const;
@@ -628,9 +1209,19 @@ public:
     return Dictionary::add_repl(mis,cor);}
   PosibErr<void> add_repl(ParmString mis, ParmString cor, ParmString s);
 
+  void memory_usage(MemReport & r) const {
+    r.begin(file_name()[0] ? file_name() : class_name);
+    add_memory_usage(r);
+    r.add("unsaved", unsaved.capacity() * sizeof(Repl));
+    r.end();
+  }
+
 private:
   PosibErr<void> save(FStream &, ParmString );
   PosibErr<void> merge(FStream &, ParmString , Config * config);
+  PosibErr<void> merge_entries(FStream &, ParmString);
+  void save_unsaved(FStream &);
+  void clear_unsaved() {unsaved.clear();}
 };
 
 WritableReplDict::Size WritableReplDict::size() const 
@@ -643,19 +1234,21 @@ bool WritableReplDict::empty() const
   return word_lookup->empty();
 }
     
+// All misspelled entries returned have intr[1] set to the dictionary
+// so that repl_lookup knows that the word points to a misspelling.
+
 bool WritableReplDict::lookup(ParmString word, const SensitiveCompare * c,
                               WordEntry & o) const
 {
   o.clear();
-  pair<WordLookup::iterator, WordLookup::iterator> p(word_lookup->equal_range(word));
-  while (p.first != p.second) {
-    if ((*c)(word,*p.first)) {
+  WordLookup::ConstFindIterator i = words().multi_find(word_key(word));
+  for (; !i.at_end(); i.adv()) {
+    if ((*c)(word,i.deref().str)) {
       o.what = WordEntry::Misspelled;
-      set_word(o, *p.first);
-      o.intr[0] = (void *)*p.first;
+      set_word(o, i.deref().str);
+      o.intr[1] = (void *)this;
       return true;
     }
-    ++p.first;
   }
   return false;
 }
@@ -663,11 +1256,11 @@ bool WritableReplDict::lookup(ParmString word, const SensitiveCompare * c,
 bool WritableReplDict::clean_lookup(ParmString sl, WordEntry & o) const
 {
   o.clear();
-  pair<WordLookup::iterator, WordLookup::iterator> p(word_lookup->equal_range(sl));
-  if (p.first == p.second) return false;
+  WordLookup::ConstFindIterator i = words().multi_find(word_key(sl));
+  if (i.at_end()) return false;
   o.what = WordEntry::Misspelled;
-  set_word(o, *p.first);
-  o.intr[0] = (void *)*p.first;
+  set_word(o, i.deref().str);
+  o.intr[1] = (void *)this;
   return true;
   // FIXME: Deal with multiple entries
 }  
@@ -675,15 +1268,16 @@ bool WritableReplDict::clean_lookup(ParmString sl, WordEntry & o) const
 bool WritableReplDict::soundslike_lookup(const WordEntry & word, WordEntry & o) const 
 {
   if (use_soundslike) {
-    const StrVector * tmp = (const StrVector *)(word.intr[0]);
     o.clear();
     o.what = WordEntry::Misspelled;
-    sl_init(tmp, o);
+    list_init(first_word(word.word), o);
+    o.intr[1] = (void *)this;
   } else {
     o.what = WordEntry::Misspelled;
     o.word = word.word;
     o.word_size = word.word_size;
     o.aff = "";
+    o.intr[1] = (void *)this;
   }
   return true;
 }
@@ -692,12 +1286,15 @@ bool WritableReplDict::soundslike_lookup(ParmString soundslike, WordEntry & o) c
 {
   if (use_soundslike) {
     o.clear();
-    SoundslikeLookup::const_iterator i = soundslike_lookup_.find(soundslike);
+    SoundslikeLookup::const_iterator i 
+      = soundslike_lookup_.find(HashedStr(soundslike, 
+                                          acommon::hash<const char *>()(soundslike)));
     if (i == soundslike_lookup_.end()) {
       return false;
     } else {
       o.what = WordEntry::Misspelled;
-      sl_init(&(i->second), o);
+      list_init(first_word(i->str), o);
+      o.intr[1] = (void *)this;
       return true;
     }
   } else {
@@ -710,54 +1307,29 @@ SoundslikeEnumeration * WritableReplDict::soundslike_elements() const {
     return new SoundslikeElements(soundslike_lookup_.begin(), 
                                   soundslike_lookup_.end());
   else
-    return new CleanElements(word_lookup->begin(),
-                             word_lookup->end());
+    return new CleanElements(words().begin(),
+                             words().end());
 }
 
 WritableReplDict::Enum * WritableReplDict::detailed_elements() const {
   return new MakeEnumeration<ElementsParms>
-    (word_lookup->begin(),ElementsParms(word_lookup->end()));
-}
-
-static void repl_next(WordEntry * w)
-{
-  const Str * & i   = (const Str * &)(w->intr[0]);
-  const Str *   end = (const Str *  )(w->intr[1]);
-  set_word(*w, *i);
-  ++i;
-  if (i == end) w->adv_ = 0;
+    (words().begin(),ElementsParms(words().end()));
 }
 
-static void repl_init(const StrVector * tmp, WordEntry & o)
-{
-  o.what = WordEntry::Word;
-  const Str * i   = tmp->pbegin();
-  const Str * end = tmp->pend();
-  set_word(o, *i);
-  ++i;
-  if (i != end) {
-    o.intr[0] = (void *)i;
-    o.intr[1] = (void *)end;
-    o.adv_ = repl_next;
-  } else {
-    o.intr[0] = 0;
-  }
-}
-  
 bool WritableReplDict::repl_lookup(const WordEntry & w, WordEntry & o) const 
 {
-  const StrVector * repls;
-  if (w.intr[0] && !w.intr[1]) { // the intr are not for the sl iter
-    repls = get_vector(w.word);
+  Str mis;
+  if (w.intr[1] == (void *)this) {
+    mis = w.word;
   } else {
     SensitiveCompare c(lang()); // FIXME: This is not exactly right
     WordEntry tmp;
-    WritableReplDict::lookup(w.word, &c, tmp);
-    repls = get_vector(tmp.word);
-    if (!repls) return false;
+    if (!WritableReplDict::lookup(w.word, &c, tmp)) return false;
+    mis = tmp.word;
   }
   o.clear();
-  repl_init(repls, o);
+  o.what = WordEntry::Word;
+  list_init(first_repl(mis), o);
   return true;
 }
 
@@ -770,44 +1342,41 @@ bool WritableReplDict::repl_lookup(ParmString word, WordEntry & o) const
 
 PosibErr<void> WritableReplDict::add_repl(ParmString mis, ParmString cor, ParmString sl) 
 {
-  Str m;
+  Str m = 0;
   SensitiveCompare cmp(lang()); // FIXME: I don't think this is completely correct
-  WordEntry we;
-
-  pair<WordLookup::iterator, WordLookup::iterator> p0(word_lookup->equal_range(mis));
-  WordLookup::iterator p = p0.first;
 
-  for (; p != p0.second && !cmp(mis,*p); ++p);
-
-  if (p == p0.second) {
-    byte * m0  = (byte *)buffer.alloc(sizeof(StrVector) + mis.size() + 3, sizeof(void *));
-    new (m0) StrVector;
-    m0 += sizeof(StrVector);
-    *m0++ = lang()->get_word_info(mis);
-    *m0++ = mis.size();
-    memcpy(m0, mis.str(), mis.size() + 1);
-    m = (char *)m0;
-    p = word_lookup->insert(m).first;
-  } else {
-    m = *p;
+  HashedStr key = word_key(mis);
+  WordLookup::ConstFindIterator i = words().multi_find(key);
+  for (; !i.at_end(); i.adv()) {
+    if (cmp(mis, i.deref().str)) {
+      m = i.deref().str;
+      break;
+    }
   }
 
-  StrVector * v = get_vector(m);
+  if (!m) {
+    m = alloc_word(buffer, mis, lang()->get_word_info(mis), 2*sizeof(Str));
+    key.str = m;
+    word_lookup->insert(key);
+    if (use_soundslike)
+      add_soundslike(m, sl);
+  }
 
-  for (StrVector::iterator i = v->begin(); i != v->end(); ++i)
-    if (cmp(cor, *i)) return no_err;
+  for (Str r = first_repl(m); r; r = next_word(r))
+    if (cmp(cor, r)) return no_err;
     
-  byte * c0 = (byte *)buffer.alloc(cor.size() + 3);
-  *c0++ = lang()->get_word_info(cor);
-  *c0++ = cor.size();
-  memcpy(c0, cor.str(), cor.size() + 1);
-  v->push_back((char *)c0);
-
-  if (use_soundslike) {
-    byte * s0 = (byte *)buffer.alloc(sl.size() + 2);
-    *s0++ = sl.size();
-    memcpy(s0, sl.str(), sl.size() + 1);
-    soundslike_lookup_[(char *)s0].push_back(m);
+  Str c = alloc_word(buffer, cor, lang()->get_word_info(cor));
+  if (first_repl(m))
+    next_word(last_repl(m)) = c;
+  else
+    first_repl(m) = c;
+  last_repl(m) = c;
+
+  if (!loading) {
+    Repl r;
+    r.mis = m;
+    r.cor = c;
+    unsaved.push_back(r);
   }
 
   return no_err;
@@ -817,26 +1386,39 @@ PosibErr<void> WritableReplDict::save (FStream & out, ParmString file_name)
 {
   out.printf("personal_repl-1.1 %s 0 %s\n", lang_name(), file_encoding.c_str());
   
-  WordLookup::iterator i = word_lookup->begin();
-  WordLookup::iterator e = word_lookup->end();
+  WordLookup::const_iterator i = words().begin();
+  WordLookup::const_iterator e = words().end();
 
   ConvP conv1(oconv);
   ConvP conv2(oconv);
   
   for (;i != e; ++i) 
   {
-    StrVector * v = get_vector(*i);
-    for (StrVector::iterator j = v->begin(); j != v->end(); ++j)
+    for (Str r = first_repl(i->str); r; r = next_word(r))
     {
-      write_n_escape(out, conv1(*i));
+      write_n_escape(out, conv1(i->str));
       out << ' ';
-      write_n_escape(out, conv2(*j));
+      write_n_escape(out, conv2(r));
       out << '\n';
     }
   }
   return no_err;
 }
 
+void WritableReplDict::save_unsaved(FStream & out)
+{
+  ConvP conv1(oconv);
+  ConvP conv2(oconv);
+  for (Vector<Repl>::iterator i = unsaved.begin(); i != unsaved.end(); ++i) {
+    write_n_escape(out, conv1(i->mis));
+    out << ' ';
+    write_n_escape(out, conv2(i->cor));
+    out << '\n';
+  }
+  file_entries += unsaved.size();
+  unsaved.clear();
+}
+
 PosibErr<void> WritableReplDict::merge(FStream & in,
                                        ParmString file_name, 
                                        Config * config)
@@ -880,21 +1462,12 @@ PosibErr<void> WritableReplDict::merge(FStream & in,
   else
     set_file_encoding("", *config);
 
+  if (loading)
+    can_append = version == 11;
+
   if (version == 11) {
 
-    ConvP conv1(iconv);
-    ConvP conv2(iconv);
-    for (;;) {
-      bool res = getline_n_unescape(in, buf, '\n');
-      if (!res) break;
-      char * mis = buf.mstr();
-      char * repl = strchr(mis, ' ');
-      if (!repl) continue; // bad line, ignore
-      *repl = '\0'; // split string
-      ++repl;
-      if (!repl[0]) continue; // empty repl, ignore
-      WritableReplDict::add_repl(conv1(mis), conv2(repl));
-    }
+    RET_ON_ERR(merge_entries(in, file_name));
     
   } else {
     
@@ -916,13 +1489,26 @@ PosibErr<void> WritableReplDict::merge(FStream & in,
   return no_err;
 }
 
-WritableReplDict::~WritableReplDict()
+PosibErr<void> WritableReplDict::merge_entries(FStream & in,
+                                               ParmString file_name)
 {
-  WordLookup::iterator i = word_lookup->begin();
-  WordLookup::iterator e = word_lookup->end();
-  
-  for (;i != e; ++i) 
-    get_vector(*i)->~StrVector();
+  String buf;
+  ConvP conv1(iconv);
+  ConvP conv2(iconv);
+  for (;;) {
+    bool res = getline_n_unescape(in, buf, '\n');
+    if (!res) break;
+    if (loading)
+      ++file_entries;
+    char * mis = buf.mstr();
+    char * repl = strchr(mis, ' ');
+    if (!repl) continue; // bad line, ignore
+    *repl = '\0'; // split string
+    ++repl;
+    if (!repl[0]) continue; // empty repl, ignore
+    WritableReplDict::add_repl(conv1(mis), conv2(repl));
+  }
+  return no_err;
 }
 
 }
@@ -18,6 +18,10 @@ namespace acommon {
     bool advance();
   };
 
+  // The scanner classifies each character with a single lookup into
+  // char_class_ and only examines the neighbours when the character
+  // is a begin or middle character.  Once the extent of the word is
+  // known the characters are copied into "word" in one pass.
   bool TokenizerBasic::advance() {
     word_begin = word_end;
     begin_pos = end_pos;
@@ -26,43 +30,49 @@ namespace acommon {
     word.clear();
 
     // skip spaces (non-word characters)
-    while (*cur != 0 &&
-	   !(is_word(*cur)
-	     || (is_begin(*cur) && is_word(cur[1])))) 
-    {
+    for (;;) {
+      unsigned int t = char_class(*cur);
+      if (t & WORD) break;
+      if (cur->chr == 0) return false;
+      if ((t & BEGIN) && is_word(cur[1])) break;
       cur_pos += cur->width;
       ++cur;
     }
 
-    if (*cur == 0) return false;
-
     word_begin = cur;
     begin_pos = cur_pos;
 
-    if (is_begin(*cur) && is_word(cur[1]))
+    if (!is_word(*cur)) // must be a begin character
     {
       cur_pos += cur->width;
       ++cur;
     }
 
-    while (is_word(*cur) || 
-	   (is_middle(*cur) && 
-	    cur > word_begin && is_word(cur[-1]) &&
-	    is_word(cur[1]) )) 
-    {
-      word.append(*cur);
-      cur_pos += cur->width;
-      ++cur;
+    FilterChar * word_start = cur;
+    for (;;) {
+      unsigned int t = char_class(*cur);
+      if (t & WORD) {
+        ++cur;
+      } else if ((t & MIDDLE) && cur > word_begin 
+                 && is_word(cur[-1]) && is_word(cur[1])) {
+        ++cur;
+      } else {
+        break;
+      }
     }
 
     if (is_end(*cur))
-    {
-      word.append(*cur);
-      cur_pos += cur->width;
       ++cur;
+
+    unsigned int size = cur - word_start;
+    word.resize(size + 1);
+    char * w = word.data();
+    for (FilterChar * i = word_start; i != cur; ++i, ++w) {
+      *w = static_cast<char>(i->chr);
+      cur_pos += i->width;
     }
+    *w = '\0';
 
-    word.append('\0');
     word_end = cur;
     end_pos = cur_pos;
 
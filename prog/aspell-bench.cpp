@@ -0,0 +1,592 @@
+// This file is part of The New Aspell
+// Copyright (C) 2004 by Kevin Atkinson under the GNU LGPL license
+// version 2.0 or 2.1.  You should have received a copy of the LGPL
+// license along with this library if you did not you can find
+// it at http://www.gnu.org/.
+
+//
+// aspell-bench: runs a fixed set of workloads and prints the timings
+// as JSON.  Everything is generated from the words of the installed
+// main dictionary using a fixed random seed so that runs of
+// different versions of Aspell with the same dictionary and options
+// can be compared.
+//
+// Usage: aspell-bench [--iterations=N] [--words=N] [--seed=N]
+//                     [--only=NAME] [--<aspell option>=VALUE] ...
+//
+// Any option not listed above is passed on to the config, for
+// example --lang=en or --dict-dir=DIR.  --only only runs the
+// benchmarks whose name starts with NAME.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "settings.h"
+
+#ifndef WIN32
+# include <unistd.h>
+#endif
+
+#include "aspell.h"
+
+#include "cache.hpp"
+#include "config.hpp"
+#include "convert.hpp"
+#include "data.hpp"
+#include "language.hpp"
+#include "posib_err.hpp"
+#include "stack_ptr.hpp"
+#include "string.hpp"
+#include "string_enumeration.hpp"
+#include "vector.hpp"
+
+using namespace acommon;
+
+static void die(const char * msg)
+{
+  fprintf(stderr, "aspell-bench: %s\n", msg);
+  exit(1);
+}
+
+static void die_on_err(AspellConfig * config)
+{
+  if (aspell_config_error(config))
+    die(aspell_config_error_message(config));
+}
+
+///////////////////////////
+//
+// timing and statistics
+//
+
+static double now_usec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+struct Result {
+  String name;
+  const char * unit;
+  Vector<double> samples;
+  unsigned long bytes; // size of the input for document checks
+  Result() : unit("usec"), bytes(0) {}
+};
+
+static Vector<Result> results;
+static const char * only = "";
+
+static bool want(const char * name)
+{
+  return strncmp(name, only, strlen(only)) == 0;
+}
+
+static Result & new_result(ParmStr name, const char * unit)
+{
+  results.push_back(Result());
+  Result & r = results.back();
+  r.name = name;
+  r.unit = unit;
+  return r;
+}
+
+static int cmp_double(const void * a, const void * b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// nearest rank percentile of sorted samples
+static double percentile(const Vector<double> & s, double p)
+{
+  unsigned i = (unsigned)(p / 100 * s.size() + 0.999999);
+  if (i == 0) i = 1;
+  if (i > s.size()) i = s.size();
+  return s[i - 1];
+}
+
+static void print_json_str(const char * str)
+{
+  putchar('"');
+  for (; *str; ++str) {
+    unsigned char c = *str;
+    if (c == '"' || c == '\\') printf("\\%c", c);
+    else if (c < 0x20)         printf("\\u%04x", c);
+    else                       putchar(c);
+  }
+  putchar('"');
+}
+
+///////////////////////////
+//
+// reproducible input
+//
+
+// A simple linear congruential generator so that the same input is
+// generated on every platform.
+class Random {
+  unsigned long state_;
+public:
+  Random(unsigned long seed) : state_(seed) {}
+  unsigned operator() (unsigned n) {
+    state_ = (state_ * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+    return (unsigned)((state_ >> 8) % n);
+  }
+};
+
+// The seed for the input of a single benchmark, so that it does not
+// depend on which other benchmarks were run before it.
+static unsigned long bench_seed(unsigned long seed, const char * name)
+{
+  unsigned long h = seed;
+  for (; *name; ++name)
+    h = 31*h + (unsigned char)*name;
+  return h;
+}
+
+static Vector<String> words;        // correct words from the dictionary
+static Vector<String> misspellings; // misspelled versions of them
+
+// Keeps a random sample of max of the words with reservoir sampling,
+// seen is the number of words looked at so far.
+static void add_words(aspeller::Dict * d, Convert * conv, unsigned max,
+                      Random & rand, unsigned & seen)
+{
+  using namespace aspeller;
+  if (d->basic_type == Dict::multi_dict) {
+    StackPtr<DictsEnumeration> els(d->dictionaries());
+    Dict * ws;
+    while (ws = els->next(), ws)
+      add_words(ws, conv, max, rand, seen);
+    return;
+  }
+  if (d->basic_type != Dict::basic_dict) return;
+  Dictionary * ws = static_cast<Dictionary *>(d);
+  StackPtr<WordEntryEnumeration> els(ws->detailed_elements());
+  WordEntry * wi;
+  CharVector buf;
+  while (wi = els->next(), wi) {
+    const char * w = wi->word;
+    if (conv) {
+      buf.clear();
+      conv->convert(wi->word, wi->word_size, buf);
+      buf.append('\0');
+      w = buf.data();
+    }
+    ++seen;
+    if (words.size() < max) {
+      words.push_back(w);
+    } else {
+      // the word replaces one of the sample with a chance of max/seen
+      unsigned i = rand(seen);
+      if (i < max) words[i] = w;
+    }
+  }
+}
+
+// The words are read directly from the main dictionary since the
+// speller does not provide the main word list.
+static void read_words(AspellConfig * c, unsigned max, Random & rand)
+{
+  using namespace aspeller;
+  StackPtr<Config> config(reinterpret_cast<Config *>(aspell_config_clone(c)));
+  find_language(*config);
+  PosibErr<Dict *> res = add_data_set(config->retrieve("master-path"), 
+                                      *config);
+  if (res.has_err()) die(res.get_err()->mesg);
+  CachePtr<Dict> dict;
+  dict.reset(res.data);
+  StackPtr<Convert> conv;
+  if (config->retrieve("encoding") != "none") {
+    PosibErr<Convert *> pe 
+      = new_convert_if_needed(*config, dict->lang()->charmap(),
+                              config->retrieve("encoding"), NormTo);
+    if (pe.has_err()) die(pe.get_err()->mesg);
+    conv.reset(pe.data);
+  }
+  unsigned seen = 0;
+  add_words(dict, conv, max, rand, seen);
+  if (words.empty()) die("the main dictionary is empty");
+}
+
+static bool is_ascii_word(const String & w)
+{
+  for (unsigned i = 0; i != w.size(); ++i)
+    if ((unsigned char)w[i] < 'A' || (unsigned char)w[i] > 'z') return false;
+  return w.size() > 2;
+}
+
+// misspell words by a single random edit the way a typist would
+static void make_misspellings(AspellSpeller * speller, unsigned num,
+                              Random & rand)
+{
+  for (unsigned tries = 0; misspellings.size() < num && tries < num * 20;
+       ++tries)
+  {
+    String w = words[rand(words.size())];
+    if (!is_ascii_word(w)) continue;
+    unsigned pos = rand(w.size() - 1);
+    char c = 'a' + rand(26);
+    switch (rand(4)) {
+    case 0: w.erase(pos, 1); break;
+    case 1: {char t = w[pos]; w[pos] = w[pos + 1]; w[pos + 1] = t;} break;
+    case 2: w[pos] = c; break;
+    case 3: w.insert(pos, &c, 1); break;
+    }
+    if (aspell_speller_check(speller, w.str(), w.size()) == 0)
+      misspellings.push_back(w);
+  }
+  if (misspellings.empty()) die("could not create any misspellings");
+}
+
+static const String & random_word(Random & rand)
+{
+  // about one word in twenty is misspelled
+  if (rand(20) == 0) return misspellings[rand(misspellings.size())];
+  return words[rand(words.size())];
+}
+
+// Generates a document for the mode with about num words of text in
+// paragraphs of a few lines each, with the markup the filters of the
+// mode need to skip.
+static void make_document(const char * mode, unsigned num,
+                          Random & rand, String & doc)
+{
+  bool html  = strcmp(mode, "html") == 0 || strcmp(mode, "sgml") == 0;
+  bool tex   = strcmp(mode, "tex") == 0;
+  bool texi  = strcmp(mode, "texinfo") == 0;
+  bool nroff = strcmp(mode, "nroff") == 0;
+  bool email = strcmp(mode, "email") == 0;
+  bool ccpp  = strcmp(mode, "ccpp") == 0;
+  bool perl  = strcmp(mode, "perl") == 0 || strcmp(mode, "comment") == 0;
+  doc.clear();
+  if (html) doc += "<html><head><title>Benchmark</title></head><body>\n";
+  if (tex)  doc += "\\documentclass{article}\n\\begin{document}\n";
+  if (texi) doc += "\\input texinfo\n@setfilename bench.info\n";
+  unsigned col = 0;
+  for (unsigned i = 0; i != num; ++i) {
+    if (i % 80 == 0) {
+      // start a new paragraph
+      if (html) doc += "<p class=\"text\">";
+      else if (tex) doc += "\\section{Part}\n";
+      else if (texi) doc += "@node Part\n@section Part\n";
+      else if (nroff) doc += ".PP\n";
+      col = 0;
+    }
+    if (col == 0) {
+      if (email && rand(3) == 0) doc += "> ";
+      else if (ccpp) doc += "// ";
+      else if (perl) doc += "# ";
+    }
+    const String & w = random_word(rand);
+    switch (rand(16)) {
+    case 0:
+      if (html) {doc += "<a href=\"http://example.com/"; doc += w;
+                 doc += "\">"; doc += w; doc += "</a>";}
+      else if (tex) {doc += "\\emph{"; doc += w; doc += '}';}
+      else if (texi) {doc += "@emph{"; doc += w; doc += '}';}
+      else if (nroff) {doc += "\\fB"; doc += w; doc += "\\fR";}
+      else doc += w;
+      break;
+    case 1:
+      if (html) {doc += "<!-- "; doc += w; doc += " -->";}
+      else if (tex) {doc += "\\cite{"; doc += w; doc += '}';}
+      else if (texi) {doc += "@code{"; doc += w; doc += '}';}
+      else {doc += "http://www.example.com/"; doc += w;}
+      break;
+    case 2:
+      doc += w; doc += "@example.com";
+      break;
+    default:
+      doc += w;
+    }
+    col += w.size() + 1;
+    if (col > 70) {
+      doc += '\n';
+      col = 0;
+      if (ccpp && rand(2) == 0) doc += "int x = y + z;\n";
+      if (perl && rand(2) == 0) doc += "my $x = $y + $z;\n";
+    } else {
+      doc += ' ';
+    }
+    if (i % 80 == 79) {
+      if (html) doc += "</p>";
+      doc += "\n\n";
+      col = 0;
+    }
+  }
+  if (html) doc += "</body></html>\n";
+  if (tex)  doc += "\\end{document}\n";
+  if (texi) doc += "@bye\n";
+}
+
+///////////////////////////
+//
+// benchmarks
+//
+
+static AspellSpeller * new_speller(AspellConfig * config)
+{
+  AspellCanHaveError * ret = new_aspell_speller(config);
+  if (aspell_error(ret)) die(aspell_error_message(ret));
+  return to_aspell_speller(ret);
+}
+
+class WordsEnumeration : public StringEnumeration {
+  const Vector<String> * words_;
+  unsigned i_;
+public:
+  WordsEnumeration(const Vector<String> & w) : words_(&w), i_(0) {}
+  WordsEnumeration * clone() const {return new WordsEnumeration(*this);}
+  void assign (const StringEnumeration * other) {
+    *this = *static_cast<const WordsEnumeration *>(other);
+  }
+  Value next() {
+    if (i_ == words_->size()) return 0;
+    return (*words_)[i_++].str();
+  }
+  bool at_end() const {return i_ == words_->size();}
+};
+
+static void bench_dict_build(AspellConfig * config0, unsigned iterations)
+{
+  if (!want("dict-build")) return;
+  String file;
+  const char * tmp = getenv("TMPDIR");
+  file = tmp ? tmp : "/tmp";
+#ifndef WIN32
+  char buf[64];
+  sprintf(buf, "/aspell-bench-%ld.rws", (long)getpid());
+  file += buf;
+#else
+  file += "/aspell-bench.rws";
+#endif
+  Result & r = new_result("dict-build", "msec");
+  for (unsigned i = 0; i != iterations; ++i) {
+    AspellConfig * c = aspell_config_clone(config0);
+    Config * config = reinterpret_cast<Config *>(c);
+    config->replace("master", file);
+    aspeller::find_language(*config);
+    double start = now_usec();
+    PosibErr<void> err
+      = aspeller::create_default_readonly_dict(new WordsEnumeration(words),
+                                               *config);
+    r.samples.push_back((now_usec() - start) / 1000);
+    delete_aspell_config(c);
+    if (err.has_err()) {
+      remove(file.str());
+      die(err.get_err()->mesg);
+    }
+  }
+  remove(file.str());
+}
+
+static void bench_speller_creation(AspellConfig * config, unsigned iterations)
+{
+  if (want("speller-cold")) {
+    Result & r = new_result("speller-cold", "msec");
+    for (unsigned i = 0; i != iterations; ++i) {
+      aspell_reset_cache(0);
+      double start = now_usec();
+      AspellSpeller * speller = new_speller(config);
+      r.samples.push_back((now_usec() - start) / 1000);
+      delete_aspell_speller(speller);
+    }
+  }
+  if (want("speller-warm")) {
+    // another speller keeps the dictionaries and language data in
+    // the cache
+    AspellSpeller * keep = new_speller(config);
+    Result & r = new_result("speller-warm", "msec");
+    for (unsigned i = 0; i != iterations; ++i) {
+      double start = now_usec();
+      AspellSpeller * speller = new_speller(config);
+      r.samples.push_back((now_usec() - start) / 1000);
+      delete_aspell_speller(speller);
+    }
+    delete_aspell_speller(keep);
+  }
+}
+
+static void bench_check(AspellSpeller * speller, const char * name,
+                        const Vector<String> & list, unsigned iterations)
+{
+  if (!want(name)) return;
+  // each sample is the average of a batch since a single check is too
+  // fast to time on its own, words left over at the end are not used
+  unsigned batch = list.size() < 1000 ? list.size() : 1000;
+  Result & r = new_result(name, "nsec");
+  for (unsigned i = 0; i != iterations; ++i) {
+    for (unsigned j = 0; j + batch <= list.size(); j += batch) {
+      unsigned end = j + batch;
+      double start = now_usec();
+      for (unsigned k = j; k != end; ++k)
+        aspell_speller_check(speller, list[k].str(), list[k].size());
+      r.samples.push_back((now_usec() - start) * 1000 / (end - j));
+    }
+  }
+}
+
+static const char * const modes[] = {
+  "none", "url", "email", "html", "sgml", "tex", "texinfo", "nroff",
+  "ccpp", "perl", "comment"
+};
+
+static void bench_documents(AspellConfig * config0, unsigned num_words,
+                            unsigned iterations, unsigned long seed)
+{
+  for (unsigned m = 0; m != sizeof(modes)/sizeof(modes[0]); ++m) {
+    String name = "document-";
+    name += modes[m];
+    if (!want(name.str())) continue;
+    AspellConfig * config = aspell_config_clone(config0);
+    if (!aspell_config_replace(config, "mode", modes[m])) {
+      // the mode is not available
+      delete_aspell_config(config);
+      continue;
+    }
+    AspellSpeller * speller = new_speller(config);
+    AspellCanHaveError * ret = new_aspell_document_checker(speller);
+    if (aspell_error(ret)) die(aspell_error_message(ret));
+    AspellDocumentChecker * checker = to_aspell_document_checker(ret);
+    String doc;
+    Random rand(bench_seed(seed, name.str()));
+    make_document(modes[m], num_words, rand, doc);
+    Result & r = new_result(name, "msec");
+    r.bytes = doc.size();
+    for (unsigned i = 0; i != iterations; ++i) {
+      double start = now_usec();
+      aspell_document_checker_reset(checker);
+      aspell_document_checker_process(checker, doc.str(), doc.size());
+      while (aspell_document_checker_next_misspelling(checker).len != 0)
+        ;
+      r.samples.push_back((now_usec() - start) / 1000);
+    }
+    delete_aspell_document_checker(checker);
+    delete_aspell_speller(speller);
+    delete_aspell_config(config);
+  }
+}
+
+static const char * const sug_modes[] = {
+  "ultra", "fast", "normal", "slow", "bad-spellers"
+};
+
+static void bench_suggest(AspellConfig * config0, unsigned num)
+{
+  for (unsigned m = 0; m != sizeof(sug_modes)/sizeof(sug_modes[0]); ++m) {
+    String name = "suggest-";
+    name += sug_modes[m];
+    if (!want(name.str())) continue;
+    AspellConfig * config = aspell_config_clone(config0);
+    aspell_config_replace(config, "sug-mode", sug_modes[m]);
+    die_on_err(config);
+    AspellSpeller * speller = new_speller(config);
+    Result & r = new_result(name, "usec");
+    unsigned n = num < misspellings.size() ? num : misspellings.size();
+    for (unsigned i = 0; i != n; ++i) {
+      double start = now_usec();
+      const AspellWordList * sugs
+        = aspell_speller_suggest(speller, misspellings[i].str(),
+                                 misspellings[i].size());
+      r.samples.push_back(now_usec() - start);
+      if (!sugs) die(aspell_speller_error_message(speller));
+    }
+    delete_aspell_speller(speller);
+    delete_aspell_config(config);
+  }
+}
+
+///////////////////////////
+//
+// main
+//
+
+int main(int argc, const char * argv[])
+{
+  unsigned iterations = 10;
+  unsigned num_words  = 20000;
+  unsigned long seed  = 1;
+
+  AspellConfig * config = new_aspell_config();
+
+  for (int i = 1; i != argc; ++i) {
+    const char * arg = argv[i];
+    if (strncmp(arg, "--", 2) != 0) {
+      fprintf(stderr, "Usage: aspell-bench [--iterations=N] [--words=N] "
+              "[--seed=N] [--only=NAME] [--<option>=VALUE] ...\n");
+      return 1;
+    }
+    arg += 2;
+    const char * eq = strchr(arg, '=');
+    String key = eq ? String(arg, eq - arg) : String(arg);
+    const char * value = eq ? eq + 1 : "true";
+    if (key == "iterations")  iterations = atoi(value);
+    else if (key == "words")  num_words = atoi(value);
+    else if (key == "seed")   seed = strtoul(value, 0, 10);
+    else if (key == "only")   only = value;
+    else {
+      aspell_config_replace(config, key.str(), value);
+      die_on_err(config);
+    }
+  }
+  if (iterations == 0) iterations = 1;
+  if (num_words == 0) num_words = 1;
+
+  Random rand(seed);
+
+  double start = now_usec();
+  AspellSpeller * speller = new_speller(config);
+  double first_speller = (now_usec() - start) / 1000;
+  read_words(config, num_words, rand);
+  make_misspellings(speller, num_words / 10 + 1, rand);
+  // nothing may be in use for the cold start
+  delete_aspell_speller(speller);
+
+  bench_dict_build(config, iterations < 3 ? iterations : 3);
+  bench_speller_creation(config, iterations);
+  speller = new_speller(config);
+  bench_check(speller, "check-correct", words, iterations);
+  bench_check(speller, "check-misspelled", misspellings, iterations);
+  bench_documents(config, num_words, iterations, seed);
+  bench_suggest(config, 200);
+
+  delete_aspell_speller(speller);
+
+  printf("{\n  \"version\": ");
+  print_json_str(aspell_version_string());
+  printf(",\n  \"lang\": ");
+  print_json_str(aspell_config_retrieve(config, "lang"));
+  printf(",\n  \"words\": %u,\n  \"misspellings\": %u,\n"
+         "  \"seed\": %lu,\n  \"iterations\": %u,\n"
+         "  \"first-speller-msec\": %.3f,\n  \"benchmarks\": [",
+         (unsigned)words.size(), (unsigned)misspellings.size(),
+         seed, iterations,
+         first_speller);
+  for (unsigned i = 0; i != results.size(); ++i) {
+    Result & r = results[i];
+    Vector<double> & s = r.samples;
+    if (s.empty()) continue;
+    qsort(s.pbegin(), s.size(), sizeof(double), cmp_double);
+    double sum = 0;
+    for (unsigned j = 0; j != s.size(); ++j) sum += s[j];
+    printf(i == 0 ? "\n    {" : ",\n    {");
+    printf("\"name\": ");
+    print_json_str(r.name.str());
+    printf(", \"unit\": \"%s\", \"count\": %u", r.unit, (unsigned)s.size());
+    if (r.bytes)
+      printf(", \"bytes\": %lu", r.bytes);
+    printf(", \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f,"
+           " \"max\": %.3f, \"mean\": %.3f}",
+           s[0], percentile(s, 50), percentile(s, 90), percentile(s, 99),
+           s.back(), sum / s.size());
+  }
+  printf("\n  ]\n}\n");
+
+  delete_aspell_config(config);
+  return 0;
+}
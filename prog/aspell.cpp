@@ -15,6 +15,7 @@
 // 
 
 #include <ctype.h>
+#include <limits.h>
 #include "settings.h"
 
 #ifdef USE_LOCALE
@@ -34,7 +35,18 @@
 # include <fcntl.h>
 #endif
 
+#ifndef WIN32
+# include <errno.h>
+# include <signal.h>
+# include <unistd.h>
+# include <poll.h>
+# include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/un.h>
+#endif
+
 #include "asc_ctype.hpp"
+#include "cache.hpp"
 #include "check_funs.hpp"
 #include "config.hpp"
 #include "convert.hpp"
@@ -45,12 +57,17 @@
 #include "fstream.hpp"
 #include "info.hpp"
 #include "iostream.hpp"
+#include "lock.hpp"
+#include "mem_report.hpp"
 #include "posib_err.hpp"
 #include "speller.hpp"
 #include "stack_ptr.hpp"
+#include "stats.hpp"
 #include "string_enumeration.hpp"
 #include "string_map.hpp"
+#include "thread.hpp"
 #include "word_list.hpp"
+#include "word_list_reader.hpp"
 
 #include "string_list.hpp"
 #include "speller_impl.hpp"
@@ -67,16 +84,18 @@ using aspeller::Conv;
 
 // action functions declarations
 
-void print_ver();
+void print_ver(OStream & out = COUT);
 void print_help(bool verbose = false);
 void config();
 
 void check();
 void pipe();
+void serve();
 void convt();
 void normlz();
 void filter();
 void list();
+void memory();
 void dicts();
 void modes();
 void filters();
@@ -171,6 +190,8 @@ const PossibleOption possible_options[] = {
   COMMAND("check",     'c',  0),
   COMMAND("pipe",      'a',  0),
   COMMAND("list",      '\0', 0),
+  COMMAND("memory",    '\0', 0),
+  COMMAND("serve",     '\0', 1),
   COMMAND("conv",      '\0', 2),
   COMMAND("norm",      '\0', 1),
   COMMAND("filter",    '\0', 0),
@@ -247,6 +268,15 @@ static void line_buffer() {
 #endif
 }
 
+static void print_stats() {
+  StringList lst;
+  get_stats(lst);
+  StringListEnumeration els = lst.elements_obj();
+  const char * line;
+  while ((line = els.next()) != 0)
+    CERR << line << "\n";
+}
+
 Conv dconv;
 Conv uiconv;
 
@@ -377,6 +407,11 @@ int main (int argc, const char *argv[])
     args.erase(args.begin() + to_remove[i]);
   }
 
+  if (options->retrieve_bool("stats")) {
+    enable_stats(true);
+    atexit(print_stats);
+  }
+
   if (args.empty()) {
     print_error(_("You must specify an action"));
     return 1;
@@ -414,8 +449,12 @@ int main (int argc, const char *argv[])
     check();
   else if (action_str == "pipe")
     pipe();
+  else if (action_str == "serve")
+    serve();
   else if (action_str == "list")
     list();
+  else if (action_str == "memory")
+    memory();
   else if (action_str == "conv")
     convt();
   else if (action_str == "norm")
@@ -644,7 +683,7 @@ bool get_word_pair(char * line, char * & w1, char * & w2)
   return true;
 }
 
-void print_elements(const AspellWordList * wl) {
+void print_elements(const AspellWordList * wl, OStream & out = COUT) {
   AspellStringEnumeration * els = aspell_word_list_elements(wl);
   int count = 0;
   const char * w;
@@ -655,7 +694,7 @@ void print_elements(const AspellWordList * wl) {
     line += ", ";
   }
   line.resize(line.size() - 2);
-  COUT.printf("%u: %s\n", count, line.c_str());
+  out.printf("%u: %s\n", count, line.c_str());
 }
 
 struct StatusFunInf 
@@ -663,7 +702,8 @@ struct StatusFunInf
   aspeller::SpellerImpl * real_speller;
   Conv oconv;
   bool verbose;
-  StatusFunInf(Convert * c) : oconv(c) {}
+  OStream * out;
+  StatusFunInf(Convert * c, OStream * o = &COUT) : oconv(c), out(o) {}
 };
 
 void status_fun(void * d, Token, int correct)
@@ -672,11 +712,11 @@ void status_fun(void * d, Token, int correct)
   if (p->verbose && correct) {
     const CheckInfo * ci = p->real_speller->check_info();
     if (ci->compound)
-      COUT.put("-\n");
+      p->out->put("-\n");
     else if (ci->pre_flag || ci->suf_flag)
-      COUT.printf("+ %s\n", p->oconv(ci->word.str()));
+      p->out->printf("+ %s\n", p->oconv(ci->word.str()));
     else
-      COUT.put("*\n");
+      p->out->put("*\n");
   }
 }
 
@@ -689,55 +729,251 @@ DocumentChecker * new_checker(AspellSpeller * speller,
   return checker.release();
 }
 
+// Reads lines from a file a large block at a time so that many lines
+// can be handled for each read.  Unlike stdio it can tell if a
+// complete line is available without blocking.
+
+class LineReader {
+  FILE * file_;
+  CharVector buf_;
+  unsigned int begin_;
+  bool eof_;
+  unsigned long skip_; // bytes still to be dropped as they are read
+  static const unsigned int block_size = 64*1024;
+public:
+  LineReader(FILE * f) : file_(f), begin_(0), eof_(false), skip_(0) {}
+  // Reads the next block, with a single read so that it does not
+  // block when the file is known to be readable.
+  void fill();
+  bool eof() const {return eof_;}
+  // the input read but not used yet
+  const char * buffered() const {return buf_.data() + begin_;}
+  unsigned int buffered_size() const {return buf_.size() - begin_;}
+  // true if the next call to getline will not need to wait for input
+  bool line_ready() const {
+    return eof_ || memchr(buf_.data() + begin_, '\n', 
+                          buf_.size() - begin_) != 0;
+  }
+  // Appends the next line, without the new line, to line.  Returns
+  // '\n' if the line ended with a new line or EOF if it is the last
+  // one.
+  int getline(CharVector & line);
+  // Appends exactly size bytes to data.  Returns false if the input
+  // ended first.
+  bool read(CharVector & data, unsigned int size);
+  // Skips size bytes.  What is not read yet is dropped as it is
+  // read, so this never waits for input.
+  void skip(unsigned long size);
+};
+
+// moves what is left of the current block to the front of the buffer
+void LineReader::fill()
+{
+  buf_.erase(buf_.begin(), buf_.begin() + begin_);
+  begin_ = 0;
+  unsigned int prev = buf_.size();
+  buf_.resize(prev + block_size);
+#ifndef WIN32
+  int s;
+  do {
+    s = ::read(fileno(file_), buf_.data() + prev, block_size);
+  } while (s == -1 && errno == EINTR);
+#else
+  int s = 0;
+  int c;
+  while (s < (int)block_size && (c = getc(file_)) != EOF) {
+    buf_[prev + s++] = static_cast<char>(c);
+    if (c == '\n') break;
+  }
+#endif
+  if (s <= 0) {eof_ = true; s = 0;}
+  unsigned int drop = skip_ < (unsigned long)s ? skip_ : s;
+  memmove(buf_.data() + prev, buf_.data() + prev + drop, s - drop);
+  skip_ -= drop;
+  buf_.resize(prev + s - drop);
+}
+
+int LineReader::getline(CharVector & line)
+{
+  for (;;) {
+    const char * b = buf_.data() + begin_;
+    const char * nl = static_cast<const char *>
+      (memchr(b, '\n', buf_.size() - begin_));
+    if (nl) {
+      line.append(b, nl - b);
+      begin_ = nl + 1 - buf_.data();
+      return '\n';
+    }
+    if (eof_) {
+      line.append(b, buf_.size() - begin_);
+      begin_ = buf_.size();
+      return EOF;
+    }
+    fill();
+  }
+}
+
+bool LineReader::read(CharVector & data, unsigned int size)
+{
+  for (;;) {
+    unsigned int avail = buf_.size() - begin_;
+    unsigned int s = avail < size ? avail : size;
+    data.append(buf_.data() + begin_, s);
+    begin_ += s;
+    size -= s;
+    if (size == 0) return true;
+    if (eof_) return false;
+    fill();
+  }
+}
+
+void LineReader::skip(unsigned long size)
+{
+  unsigned int avail = buf_.size() - begin_;
+  unsigned int s = avail < size ? avail : size;
+  begin_ += s;
+  skip_ = size - s;
+}
+
 #define BREAK_ON_SPELLER_ERR\
   do {if (aspell_speller_error(speller)) {\
     print_error(aspell_speller_error_message(speller)); break;\
   } } while (false)
 
-void pipe() 
+struct PipeState {
+  bool print_star;   // false after a "!", true after a "%"
+  bool allow_switch; // if "$$cs lang,<lang>" may switch spellers
+  String lang;       // the language to switch to
+  bool modified;     // if the speller was changed by a request
+  bool until_idle;   // return once no whole request is buffered
+  PipeState() : print_star(true), allow_switch(false), modified(false),
+                until_idle(false) {}
+};
+
+// why pipe_session returned
+enum SessionEnd {SessionClosed, SessionSwitch, SessionIdle};
+
+// A batch request, "$$bc <id> <size> [<option>=<value> ...]", is
+// followed by <size> bytes of text which are checked as a single
+// document.  The answer is "$$bc <id> <count> <size>" followed by
+// <size> bytes holding an "<offset> <length> <word>[: <sug>, ...]"
+// line for each of the <count> misspelled words, or "$$be <id>
+// <message>" if the request could not be done, including when the
+// input ends before the text does.  The options are "mode", "suggest"
+// and "max-sug".  A text larger than max_batch_size is skipped
+// without being read in.  If the size is not a number, or is too
+// large to represent, the text can not be told apart from the
+// requests after it, so the session ends.
+
+static const unsigned long max_batch_size = 64*1024*1024;
+
+struct BatchRequest {
+  const char * id;
+  unsigned long size;
+  const char * mode;    // 0 to keep the current mode
+  int suggest;          // -1 to keep the current setting
+  int max_sug;          // -1 for no limit
+  const char * invalid; // the first invalid option or 0
+};
+
+static char * next_field(char * & p)
 {
-  line_buffer();
+  while (asc_isspace(*p)) ++p;
+  if (*p == '\0') return 0;
+  char * f = p;
+  while (*p != '\0' && !asc_isspace(*p)) ++p;
+  if (*p != '\0') *p++ = '\0';
+  return f;
+}
 
-  bool terse_mode = true;
-  bool do_time = options->retrieve_bool("time");
-  bool suggest = options->retrieve_bool("suggest");
-  bool include_guesses = options->retrieve_bool("guess");
-  clock_t start,finish;
+// Returns false if the header has no id or size, or the size is not a
+// number, in which case req.id is the id if there is one.
 
-  if (!options->have("mode") && !options->have("filter")) {
-    PosibErrBase err(options->replace("mode", "nroff"));
-    if (err.has_err()) 
-      CERR.printf(_("WARNING: Unable to enter Nroff mode: %s\n"),
-                  err.get_err()->mesg);
+static bool parse_batch_request(char * p, BatchRequest & req)
+{
+  req.mode = 0;
+  req.suggest = -1;
+  req.max_sug = -1;
+  req.invalid = 0;
+  char * end;
+  req.id = next_field(p);
+  char * size = next_field(p);
+  if (!req.id || !size) return false;
+  // strtoul is not used as it accepts a sign and wraps around
+  req.size = 0;
+  for (end = size; asc_isdigit(*end); ++end) {
+    if (req.size > (ULONG_MAX - 9) / 10) return false;
+    req.size = req.size * 10 + (*end - '0');
+  }
+  if (end == size || *end != '\0') return false;
+  while (char * opt = next_field(p)) {
+    char * val = strchr(opt, '=');
+    if (val) *val++ = '\0';
+    if (val && strcmp(opt, "mode") == 0) {
+      req.mode = val;
+    } else if (val && strcmp(opt, "suggest") == 0 
+               && (strcmp(val, "true") == 0 || strcmp(val, "false") == 0)) {
+      req.suggest = val[0] == 't';
+    } else if (val && strcmp(opt, "max-sug") == 0 
+               && (req.max_sug = strtoul(val, &end, 10), *end == '\0')) {
+      // nothing else to do
+    } else if (!req.invalid) {
+      if (val) val[-1] = '=';
+      req.invalid = opt;
+    }
   }
+  return true;
+}
 
-  start = clock();
-  
-  AspellCanHaveError * ret 
-    = new_aspell_speller(reinterpret_cast<AspellConfig *>(options.get()));
-  if (aspell_error(ret)) {
-    print_error(aspell_error_message(ret));
-    exit(1);
-  }
-  AspellSpeller * speller = to_aspell_speller(ret);
+// True if the next request, including the text of a batch request,
+// can be answered without waiting for input.
+
+static bool request_ready(const LineReader & in)
+{
+  if (in.eof()) return true;
+  const char * b = in.buffered();
+  const char * e = b + in.buffered_size();
+  const char * nl = static_cast<const char *>(memchr(b, '\n', e - b));
+  if (!nl) return false;
+  if (nl - b < 4 || memcmp(b, "$$bc", 4) != 0) return true;
+  String header(b + 4, nl - b - 4);
+  BatchRequest req;
+  if (!parse_batch_request(header.mstr(), req) || req.size > max_batch_size)
+    return true;
+  return (unsigned long)(e - nl - 1) >= req.size;
+}
+
+// Answers pipe mode requests read from in until the input runs out,
+// and returns SessionClosed.  If st.allow_switch is set a "$$cs
+// lang,<lang>" request ends the session early and returns
+// SessionSwitch with the language in st.lang, so that the caller can
+// continue the session with a speller for that language.  If
+// st.until_idle is set SessionIdle is returned, after flushing out,
+// once answering the next request would have to wait for input.
+
+SessionEnd pipe_session(AspellSpeller * speller, LineReader & in, 
+                        FStream & out, bool buffered, PipeState & st)
+{
+  bool terse_mode = true;
+  clock_t start,finish;
   aspeller::SpellerImpl * real_speller = reinterpret_cast<aspeller::SpellerImpl *>(speller);
   Config * config = real_speller->config();
+  bool do_time = config->retrieve_bool("time");
+  bool suggest = config->retrieve_bool("suggest");
+  bool include_guesses = config->retrieve_bool("guess");
   Conv iconv(setup_conv(config, &real_speller->lang()));
   Conv oconv(setup_conv(&real_speller->lang(), config));
   MBLen mb_len;
   if (!config->retrieve_bool("byte-offsets")) 
     mb_len.setup(*config, config->retrieve("encoding"));
-  if (do_time)
-    COUT << _("Time to load word list: ")
-         << (clock() - start)/(double)CLOCKS_PER_SEC << "\n";
-  StatusFunInf status_fun_inf(setup_conv(&real_speller->lang(), config));
+  StatusFunInf status_fun_inf(setup_conv(&real_speller->lang(), config), &out);
   status_fun_inf.real_speller = real_speller;
-  bool & print_star = status_fun_inf.verbose;
-  print_star = true;
+  status_fun_inf.verbose = st.print_star;
   StackPtr<DocumentChecker> checker(new_checker(speller, status_fun_inf));
   int c;
   const char * w;
   CharVector buf;
+  CharVector doc;
   char * line;
   char * line0;
   char * word;
@@ -745,13 +981,15 @@ void pipe()
   int    ignore;
   PosibErrBase err;
 
-  print_ver();
-
   for (;;) {
     buf.clear();
-    fflush(stdout);
-    while (c = getchar(), c != '\n' && c != EOF)
-      buf.push_back(static_cast<char>(c));
+    if (st.until_idle && !request_ready(in)) {
+      out.flush();
+      return SessionIdle;
+    }
+    if (!buffered || !in.line_ready())
+      out.flush();
+    c = in.getline(buf);
     buf.push_back('\n'); // always add new line so strlen > 0
     buf.push_back('\0');
     line = buf.data();
@@ -762,11 +1000,13 @@ void pipe()
       else          break;
     case '*':
       word = trim_wspace(line + 1);
+      st.modified = true;
       aspell_speller_add_to_personal(speller, word, -1);
       BREAK_ON_SPELLER_ERR;
       break;
     case '&':
       word = trim_wspace(line + 1);
+      st.modified = true;
       aspell_speller_add_to_personal
 	(speller, 
 	 real_speller->to_lower(word), -1);
@@ -783,6 +1023,7 @@ void pipe()
       break;
     case '+':
       word = trim_wspace(line + 1);
+      st.modified = true;
       err = config->replace("mode", word);
       if (err.get_err())
 	config->replace("mode", "tex");
@@ -791,6 +1032,7 @@ void pipe()
       checker = new_checker(speller, status_fun_inf);
       break;
     case '-':
+      st.modified = true;
       config->remove("filter");
       reload_filters(real_speller);
       checker.del();
@@ -800,11 +1042,11 @@ void pipe()
       break;
     case '!':
       terse_mode = true;
-      print_star = false;
+      st.print_star = status_fun_inf.verbose = false;
       break;
     case '%':
       terse_mode = false;
-      print_star = true;
+      st.print_star = status_fun_inf.verbose = true;
       break;
     case '$':
       if (line[1] == '$') {
@@ -812,16 +1054,24 @@ void pipe()
 	case 'r':
 	  switch(line[3]) {
 	  case 'a':
-	    if (get_word_pair(line + 4, word, word2))
+	    if (get_word_pair(line + 4, word, word2)) {
+	      st.modified = true;
 	      aspell_speller_store_replacement(speller, word, -1, word2, -1);
+	    }
 	    break;
 	  }
 	  break;
 	case 'c':
 	  switch (line[3]) {
 	  case 's':
-	    if (get_word_pair(line + 4, word, word2))
-	      BREAK_ON_ERR(err = config->replace(word, word2));
+	    if (!get_word_pair(line + 4, word, word2))
+	      break;
+	    if (st.allow_switch && strcmp(word, "lang") == 0) {
+	      st.lang = word2;
+	      return SessionSwitch;
+	    }
+	    st.modified = true;
+	    BREAK_ON_ERR(err = config->replace(word, word2));
             if (strcmp(word,"suggest") == 0)
               suggest = config->retrieve_bool("suggest");
             else if (strcmp(word,"time") == 0)
@@ -832,22 +1082,117 @@ void pipe()
 	  case 'r':
 	    word = trim_wspace(line + 4);
 	    BREAK_ON_ERR_SET(config->retrieve(word), String, ret);
-            COUT.printl(ret);
+            out.printl(ret);
 	    break;
 	  }
 	  break;
 	case 'p':
 	  switch (line[3]) {
 	  case 'p':
-	    print_elements(aspell_speller_personal_word_list(speller));
+	    print_elements(aspell_speller_personal_word_list(speller), out);
 	    break;
 	  case 's':
-	    print_elements(aspell_speller_session_word_list(speller));
+	    print_elements(aspell_speller_session_word_list(speller), out);
 	    break;
 	  }
 	  break;
 	case 'l':
-	  COUT.printl(config->retrieve("lang"));
+	  out.printl(config->retrieve("lang"));
+	  break;
+	case 'b':
+	  if (line[3] == 'c') {
+	    BatchRequest req;
+	    if (!parse_batch_request(line + 4, req)) {
+	      if (req.id)
+		out.printf("$$be %s %s\n", req.id, _("Invalid batch request."));
+	      else
+		print_error(_("Invalid batch request."));
+	      c = EOF;
+	      break;
+	    }
+	    if (req.size > max_batch_size) {
+	      out.printf("$$be %s ", req.id);
+	      out.printf(_("The text is larger than the limit of %lu bytes."),
+			 max_batch_size);
+	      out.put('\n');
+	      in.skip(req.size);
+	      break;
+	    }
+	    doc.clear();
+	    if (!in.read(doc, req.size)) {
+	      out.printf("$$be %s ", req.id);
+	      out.printf(_("The input ended after %u of the %u bytes."),
+			 (unsigned int)doc.size(), (unsigned int)req.size);
+	      out.put('\n');
+	      c = EOF;
+	      break;
+	    }
+	    if (req.invalid) {
+	      out.printf("$$be %s ", req.id);
+	      out.printf(_("The option \"%s\" is not valid."), req.invalid);
+	      out.put('\n');
+	      break;
+	    }
+	    String prev_mode;
+	    if (req.mode) {
+	      String cur_mode = config->retrieve("mode");
+	      if (cur_mode != req.mode) {
+		err = config->replace("mode", req.mode);
+		if (err.has_err()) {
+		  out.printf("$$be %s %s\n", req.id, err.get_err()->mesg);
+		  break;
+		}
+		prev_mode = cur_mode;
+		st.modified = true;
+		reload_filters(real_speller);
+		checker.del();
+		checker = new_checker(speller, status_fun_inf);
+	      }
+	    }
+	    bool sug = req.suggest == -1 ? suggest : req.suggest;
+	    bool verbose = status_fun_inf.verbose;
+	    status_fun_inf.verbose = false;
+	    unsigned int size = doc.size();
+	    doc.push_back('\0');
+	    checker->reset();
+	    checker->process(doc.data(), size);
+	    String res;
+	    unsigned int count = 0, pos = 0, offset = 0;
+	    while (Token token = checker->next_misspelling()) {
+	      ++count;
+	      word = doc.data() + token.offset;
+	      char next = word[token.len];
+	      word[token.len] = '\0';
+	      offset += mb_len(doc.data() + pos, word);
+	      pos = token.offset;
+	      res.printf("%u %u %s", offset, mb_len(word, token.len), word);
+	      if (sug) {
+		const AspellWordList * suggestions 
+		  = aspell_speller_suggest(speller, word, -1);
+		AspellStringEnumeration * els 
+		  = aspell_word_list_elements(suggestions);
+		const char * sep = ": ";
+		for (int n = 0; n != req.max_sug 
+		       && (w = aspell_string_enumeration_next(els)) != 0; ++n) {
+		  res << sep << w;
+		  sep = ", ";
+		}
+		delete_aspell_string_enumeration(els);
+	      }
+	      res << '\n';
+	      word[token.len] = next;
+	    }
+	    status_fun_inf.verbose = verbose;
+	    if (!prev_mode.empty()) {
+	      config->replace("mode", prev_mode);
+	      reload_filters(real_speller);
+	      checker.del();
+	      checker = new_checker(speller, status_fun_inf);
+	    }
+	    out.printf("$$bc %s %u %u\n", req.id, count, 
+		       (unsigned int)res.size());
+	    out.write(res.data(), res.size());
+	  }
 	  break;
 	}
 	break;
@@ -892,51 +1237,443 @@ void pipe()
         unsigned offset = mb_len(line0, token.offset + ignore);
 	if (suggestions && !aspell_word_list_empty(suggestions)) 
         {
-          COUT.printf("& %s %u %u:", word, 
+          out.printf("& %s %u %u:", word, 
                       aspell_word_list_size(suggestions), offset);
 	  AspellStringEnumeration * els 
 	    = aspell_word_list_elements(suggestions);
-	  if (options->retrieve_bool("reverse")) {
+	  if (config->retrieve_bool("reverse")) {
 	    Vector<String> sugs;
 	    sugs.reserve(aspell_word_list_size(suggestions));
 	    while ( ( w = aspell_string_enumeration_next(els)) != 0)
 	      sugs.push_back(w);
 	    Vector<String>::reverse_iterator i = sugs.rbegin();
 	    while (true) {
-              COUT.printf(" %s", i->c_str());
+              out.printf(" %s", i->c_str());
 	      ++i;
 	      if (i == sugs.rend()) break;
-              COUT.put(',');
+              out.put(',');
 	    }
 	  } else {
 	    while ( ( w = aspell_string_enumeration_next(els)) != 0) {
-              COUT.printf(" %s%s", w, 
+              out.printf(" %s%s", w, 
                           aspell_string_enumeration_at_end(els) ? "" : ",");
 	    }
 	  }
 	  delete_aspell_string_enumeration(els);
           if (include_guesses)
-            COUT.put(guesses);
-	  COUT.put('\n');
+            out.put(guesses);
+	  out.put('\n');
 	} else {
           if (guesses.empty())
-            COUT.printf("# %s %u\n", word, offset);
+            out.printf("# %s %u\n", word, offset);
           else
-            COUT.printf("? %s 0 %u: %s\n", word, offset,
+            out.printf("? %s 0 %u: %s\n", word, offset,
                         guesses.c_str() + 2);
 	}
 	if (do_time)
-          COUT.printf(_("Suggestion Time: %f\n"), 
+          out.printf(_("Suggestion Time: %f\n"), 
                       (finish-start)/(double)CLOCKS_PER_SEC);
       }
-      COUT.put('\n');
+      out.put('\n');
     }
     if (c == EOF) break;
   }
 
+  return SessionClosed;
+}
+
+
+void pipe() 
+{
+  // In buffered mode the output is only flushed once all of the
+  // input which is available has been answered.
+  bool buffered = options->retrieve_bool("buffer-pipe");
+  if (buffered)
+    setvbuf(stdout, 0, _IOFBF, 64*1024);
+  else
+    line_buffer();
+
+  clock_t start = clock();
+
+  if (!options->have("mode") && !options->have("filter")) {
+    PosibErrBase err(options->replace("mode", "nroff"));
+    if (err.has_err()) 
+      CERR.printf(_("WARNING: Unable to enter Nroff mode: %s\n"),
+                  err.get_err()->mesg);
+  }
+
+  AspellCanHaveError * ret 
+    = new_aspell_speller(reinterpret_cast<AspellConfig *>(options.get()));
+  if (aspell_error(ret)) {
+    print_error(aspell_error_message(ret));
+    exit(1);
+  }
+  AspellSpeller * speller = to_aspell_speller(ret);
+  if (options->retrieve_bool("time"))
+    COUT << _("Time to load word list: ")
+         << (clock() - start)/(double)CLOCKS_PER_SEC << "\n";
+
+  print_ver();
+
+  LineReader in(stdin);
+  PipeState st;
+  pipe_session(speller, in, COUT, buffered, st);
+
   delete_aspell_speller(speller);
 }
 
+///////////////////////////
+//
+// serve
+//
+
+#ifndef WIN32
+
+// Spellers which are not currently used by a client, by the language
+// the client asked for.  Reusing them means a client does not have to
+// wait for a speller to be set up, and all of the spellers share
+// the same read-only dictionaries through the global cache.
+
+class SpellerPool {
+  struct Idle {
+    String lang;
+    AspellSpeller * speller;
+  };
+  Mutex lock_;
+  Vector<Idle> idle_;
+public:
+  ~SpellerPool() {
+    for (Vector<Idle>::iterator i = idle_.begin(); i != idle_.end(); ++i)
+      delete_aspell_speller(i->speller);
+  }
+  // returns 0 if a speller for lang could not be created
+  AspellSpeller * get(const String & lang);
+  // A speller which was modified by its client is deleted rather
+  // than handed to the next one.
+  void put(const String & lang, AspellSpeller *, bool modified);
+};
+
+AspellSpeller * SpellerPool::get(const String & lang)
+{
+  {
+    LOCK(&lock_);
+    for (Vector<Idle>::iterator i = idle_.begin(); i != idle_.end(); ++i) {
+      if (i->lang == lang) {
+        AspellSpeller * speller = i->speller;
+        idle_.erase(i);
+        return speller;
+      }
+    }
+  }
+  StackPtr<Config> config(options->clone());
+  if (!lang.empty()) {
+    PosibErrBase pe(config->replace("lang", lang));
+    if (pe.has_err()) {print_error(pe.get_err()->mesg); return 0;}
+  }
+  AspellCanHaveError * ret 
+    = new_aspell_speller(reinterpret_cast<AspellConfig *>(config.get()));
+  if (aspell_error(ret)) {
+    print_error(aspell_error_message(ret));
+    delete_aspell_can_have_error(ret);
+    return 0;
+  }
+  return to_aspell_speller(ret);
+}
+
+void SpellerPool::put(const String & lang, AspellSpeller * speller, 
+                      bool modified)
+{
+  if (modified) {
+    delete_aspell_speller(speller);
+    return;
+  }
+  aspell_speller_clear_session(speller);
+  Idle i;
+  i.lang = lang;
+  i.speller = speller;
+  LOCK(&lock_);
+  idle_.push_back(i);
+}
+
+// A connected client.  The speller and the state of the session are
+// kept with the client rather than with a thread, so that whichever
+// worker is free can answer its next requests.
+
+struct ServeClient {
+  FILE * in_file;
+  LineReader in;
+  FStream out;
+  String lang;
+  AspellSpeller * speller; // 0 until the session is started
+  PipeState st;
+  ServeClient(FILE * i, FILE * o) : in_file(i), in(i), out(o), speller(0) {
+    st.allow_switch = true;
+    st.until_idle = true;
+  }
+  int fd() const {return fileno(in_file);}
+};
+
+static ServeClient * new_serve_client(int fd)
+{
+  FILE * in_file = fdopen(fd, "r");
+  if (!in_file) {close(fd); return 0;}
+  int out_fd = dup(fd);
+  FILE * out_file = out_fd != -1 ? fdopen(out_fd, "w") : 0;
+  if (!out_file) {
+    if (out_fd != -1) close(out_fd);
+    fclose(in_file); 
+    return 0;
+  }
+  setvbuf(out_file, 0, _IOFBF, 64*1024);
+  return new ServeClient(in_file, out_file);
+}
+
+static void delete_serve_client(ServeClient * cl, SpellerPool & pool)
+{
+  if (cl->speller) pool.put(cl->lang, cl->speller, cl->st.modified);
+  cl->out.flush();
+  fclose(cl->in_file);
+  delete cl;
+}
+
+// Answers the requests of a client which can be answered without
+// waiting for input, starting the session the first time.  Returns
+// false once the client is gone.
+
+static bool serve_requests(ServeClient * cl, SpellerPool & pool)
+{
+  if (!cl->speller) {
+    cl->speller = pool.get(cl->lang);
+    if (!cl->speller) return false;
+    print_ver(cl->out);
+  }
+  for (;;) {
+    SessionEnd res = pipe_session(cl->speller, cl->in, cl->out, true, cl->st);
+    if (res == SessionClosed) return false;
+    if (res == SessionIdle) return true;
+    AspellSpeller * other = pool.get(cl->st.lang);
+    if (!other) continue;
+    pool.put(cl->lang, cl->speller, cl->st.modified);
+    cl->lang = cl->st.lang;
+    cl->speller = other;
+    cl->st.modified = false;
+  }
+}
+
+// The main thread waits for input from all of the clients at once
+// and hands a client with a whole request to answer to the workers
+// through the todo pipe.  Once a worker answered all of the requests
+// it can, the client is handed back through the done pipe to wait for
+// more input.  The pipes carry pointers to the clients, which are
+// written and read whole.
+
+struct ServeQueue {
+  SpellerPool * pool;
+  int num_workers; // if 0 the clients are answered by the main thread
+  int todo[2];
+  int done[2];
+};
+
+static bool read_client(int fd, ServeClient * & cl)
+{
+  ssize_t s;
+  do {
+    s = read(fd, &cl, sizeof(cl));
+  } while (s == -1 && errno == EINTR);
+  return s == sizeof(cl);
+}
+
+static void write_client(int fd, ServeClient * cl)
+{
+  ssize_t s;
+  do {
+    s = write(fd, &cl, sizeof(cl));
+  } while (s == -1 && errno == EINTR);
+}
+
+static void * serve_worker(void * d)
+{
+  ServeQueue * q = static_cast<ServeQueue *>(d);
+  ServeClient * cl;
+  while (read_client(q->todo[0], cl)) {
+    if (serve_requests(cl, *q->pool))
+      write_client(q->done[1], cl);
+    else
+      delete_serve_client(cl, *q->pool);
+  }
+  return 0;
+}
+
+static void answer_client(ServeClient * cl, ServeQueue & q,
+                          Vector<ServeClient *> & waiting)
+{
+  if (q.num_workers > 0)
+    write_client(q.todo[1], cl);
+  else if (serve_requests(cl, *q.pool))
+    waiting.push_back(cl);
+  else
+    delete_serve_client(cl, *q.pool);
+}
+
+void serve()
+{
+  String path = args[0];
+
+  // a client going away in the middle of an answer should not take
+  // the server with it
+  signal(SIGPIPE, SIG_IGN);
+
+  if (!options->have("mode") && !options->have("filter")) {
+    PosibErrBase err(options->replace("mode", "nroff"));
+    if (err.has_err()) 
+      CERR.printf(_("WARNING: Unable to enter Nroff mode: %s\n"),
+                  err.get_err()->mesg);
+  }
+
+  // load the default language and any others listed now so the
+  // first clients do not have to wait for them
+  SpellerPool pool;
+  for (unsigned i = 0; i != args.size(); ++i) {
+    String lang = i == 0 ? String() : args[i];
+    AspellSpeller * speller = pool.get(lang);
+    if (!speller) exit(1);
+    pool.put(lang, speller, false);
+  }
+
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    print_error(_("The socket name \"%s\" is too long."), path);
+    exit(1);
+  }
+  memcpy(addr.sun_path, path.str(), path.size());
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock == -1) {
+    print_error(strerror(errno));
+    exit(1);
+  }
+  int res = bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+  if (res == -1 && errno == EADDRINUSE) {
+    // only remove a socket left behind by a server which is no longer
+    // running, never any other kind of file
+    struct stat st;
+    if (lstat(path.str(), &st) != 0 || !S_ISSOCK(st.st_mode)) {
+      print_error(_("The file \"%s\" exists and is not a socket."), path);
+      exit(1);
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool live = probe != -1 
+      && connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    if (probe != -1) close(probe);
+    if (live) {
+      print_error(_("The socket \"%s\" is in use by another server."), path);
+      exit(1);
+    }
+    unlink(path.str());
+    res = bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+  }
+  if (res == -1 || listen(sock, 64) == -1) {
+    print_error(strerror(errno));
+    exit(1);
+  }
+
+  // The "threads" option gives the number of workers, and so the
+  // number of clients whose requests are answered at once.  Clients
+  // waiting for input do not take up a worker.
+  ServeQueue q;
+  q.pool = &pool;
+  q.num_workers = 8;
+  if (options->have("threads"))
+    q.num_workers = options->retrieve_int("threads");
+  if (q.num_workers < 1) q.num_workers = 1;
+#ifndef USE_POSIX_MUTEX
+  q.num_workers = 0;
+#endif
+  if (pipe(q.todo) == -1 || pipe(q.done) == -1) {
+    print_error(strerror(errno));
+    exit(1);
+  }
+  Thread * workers = new Thread[q.num_workers];
+  for (int i = 0; i != q.num_workers; ++i)
+    workers[i].start(serve_worker, &q);
+
+  Vector<ServeClient *> waiting, still_waiting;
+  Vector<pollfd> fds;
+  for (;;) {
+    fds.clear();
+    pollfd p;
+    p.events = POLLIN;
+    p.revents = 0;
+    p.fd = sock;
+    fds.push_back(p);
+    p.fd = q.done[0];
+    fds.push_back(p);
+    for (unsigned i = 0; i != waiting.size(); ++i) {
+      p.fd = waiting[i]->fd();
+      fds.push_back(p);
+    }
+    if (poll(fds.data(), fds.size(), -1) == -1) {
+      if (errno == EINTR) continue;
+      print_error(strerror(errno));
+      break;
+    }
+    still_waiting.clear();
+    for (unsigned i = 0; i != waiting.size(); ++i) {
+      ServeClient * cl = waiting[i];
+      if (fds[i + 2].revents) {
+        cl->in.fill();
+        if (request_ready(cl->in)) {
+          answer_client(cl, q, still_waiting);
+          continue;
+        }
+      }
+      still_waiting.push_back(cl);
+    }
+    waiting.swap(still_waiting);
+    ServeClient * cl;
+    if (fds[1].revents && read_client(q.done[0], cl))
+      waiting.push_back(cl);
+    if (fds[0].revents) {
+      int fd = accept(sock, 0, 0);
+      if (fd == -1) {
+        if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)
+          continue;
+        print_error(strerror(errno));
+        break;
+      }
+      // the new client gets the version line right away
+      cl = new_serve_client(fd);
+      if (cl) answer_client(cl, q, waiting);
+    }
+  }
+
+  close(q.todo[1]);
+  for (int i = 0; i != q.num_workers; ++i)
+    workers[i].join();
+  delete[] workers;
+  close(q.done[1]);
+  ServeClient * cl;
+  while (read_client(q.done[0], cl))
+    waiting.push_back(cl);
+  for (unsigned i = 0; i != waiting.size(); ++i)
+    delete_serve_client(waiting[i], pool);
+  close(q.todo[0]);
+  close(q.done[0]);
+  close(sock);
+  unlink(path.str());
+}
+
+#else
+
+void serve()
+{
+  print_error(_("The \"serve\" command is not supported on this platform."));
+  exit(1);
+}
+
+#endif
+
 ///////////////////////////
 //
 // check
@@ -1294,6 +2031,38 @@ void list()
   }
   AspellSpeller * speller = to_aspell_speller(ret);
 
+  if (options->retrieve_int("threads") > 1) {
+    // Read the input in large blocks ending at a line break so that
+    // the document checker has enough text to split between threads.
+    EXIT_ON_ERR_SET(new_document_checker(reinterpret_cast<Speller *>(speller)),
+                    StackPtr<DocumentChecker>, checker);
+    static const size_t block_size = 1024*1024;
+    String buf;
+    bool eof = false;
+    while (!eof) {
+      size_t prev = buf.size();
+      buf.resize(prev + block_size);
+      size_t s = fread(buf.data() + prev, 1, block_size, stdin);
+      buf.resize(prev + s);
+      eof = s == 0;
+      size_t end = buf.size();
+      if (!eof) {
+        while (end > 0 && buf[end - 1] != '\n') --end;
+        if (end == 0) continue;
+      }
+      checker->process(buf.data(), end);
+      for (;;) {
+        Token tok = checker->next_misspelling();
+        if (tok.len == 0) break;
+        COUT.write(buf.data() + tok.offset, tok.len);
+        COUT.put('\n');
+      }
+      buf.erase(0, end);
+    }
+    delete_aspell_speller(speller);
+    return;
+  }
+
   state = new CheckerString(speller,stdin,0,64);
 
   String word;
@@ -1309,6 +2078,40 @@ void list()
   delete_aspell_speller(speller);
 }
 
+///////////////////////////
+//
+// memory
+//
+
+void memory()
+{
+  AspellCanHaveError * ret 
+    = new_aspell_speller(reinterpret_cast<AspellConfig *>(options.get()));
+  if (aspell_error(ret)) {
+    print_error(aspell_error_message(ret));
+    exit(1);
+  }
+  AspellSpeller * speller = to_aspell_speller(ret);
+
+  EXIT_ON_ERR_SET(new_document_checker(reinterpret_cast<Speller *>(speller)),
+                  StackPtr<DocumentChecker>, checker);
+
+  MemReport r;
+  reinterpret_cast<Speller *>(speller)->memory_usage(r);
+  r.begin("document filters");
+  if (checker->filter()) checker->filter()->memory_usage(r);
+  r.end();
+  StringList lst;
+  r.write(lst);
+  cache_memory_report(lst);
+  StringListEnumeration els = lst.elements_obj();
+  const char * line;
+  while ((line = els.next()) != 0)
+    COUT << line << "\n";
+
+  delete_aspell_speller(speller);
+}
+
 ///////////////////////////
 //
 // convt
@@ -1393,9 +2196,9 @@ void filter()
 // print_ver
 //
 
-void print_ver () {
-  printf("@(#) International Ispell Version 3.1.20 " 
-         "(but really Aspell %s)\n", aspell_version_string());
+void print_ver (OStream & out) {
+  out.printf("@(#) International Ispell Version 3.1.20 " 
+             "(but really Aspell %s)\n", aspell_version_string());
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -1511,9 +2314,14 @@ void master () {
   if (action == do_create) {
     
     find_language(*config);
-    EXIT_ON_ERR(create_default_readonly_dict
-                (new IstreamEnumeration(CIN),
-                 *config));
+    // the word lists to read may follow the name, which may be
+    // compressed, otherwise the words are read from standard input
+    WordListReader in;
+    for (unsigned i = 1; i < args.size(); ++i)
+      in.add(args[i]);
+    if (args.size() <= 1)
+      in.add("-");
+    EXIT_ON_ERR(create_default_readonly_dict(&in, *config));
 
   } else if (action == do_merge) {
     
@@ -2820,6 +3628,9 @@ static const char * help_text[] =
   usage_text[4],
   usage_text[5],
   N_("  list             produce a list of misspelled words from standard input"),
+  N_("  memory           shows the memory used by a speller and the global caches"),
+  N_("  serve <socket> [<lang>...]"),
+  N_("    answers pipe mode requests from clients of a unix socket"),
   usage_text[6],
   usage_text[7],
   N_("  soundslike       returns the sounds like equivalent for each word entered"),
@@ -2838,6 +3649,8 @@ static const char * help_text[] =
   usage_text[9],
   N_("  dump|create|merge master|personal|repl [<name>]"),
   N_("    dumps, creates or merges a master, personal, or replacement dictionary."),
+  N_("  create master <name> <file>..."),
+  N_("    creates a master dictionary from word lists which may be compressed"),
   "",
   /* TRANSLATORS: "none", "internal" and "strict" are literal values
      and should not be translated. */